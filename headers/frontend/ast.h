@@ -1,6 +1,7 @@
 #ifndef AST_H
 #define AST_H
 #include <stddef.h>
+#include <stdint.h>
 typedef enum
 {
     // Literals
@@ -11,13 +12,21 @@ typedef enum
     EXPR_UnaryExpr,
     EXPR_BinaryExpr,
     EXPR_AssignmentExpr,
+    EXPR_ArrayLiteral,
+    EXPR_IndexExpr,
+    EXPR_CallExpr,
+    EXPR_MapLiteral,
+    EXPR_MemberExpr,
+    EXPR_RecordLiteral,
+    EXPR_TemplateLiteral,
 } ExprType;
 
 struct Expr;
 
 typedef struct
 {
-    int x;
+    int64_t x;
+    char *digits; // Decimal digits of a literal too big for int64_t,NULL otherwise.
 } NumericLiteral;
 
 typedef struct
@@ -25,9 +34,13 @@ typedef struct
     char *s;
 } StringLiteral;
 
+#define VAR_UNRESOLVED SIZE_MAX // The slot of a name that is looked up when it's evaluated.
+
 typedef struct
 {
     char *symbol;
+    size_t depth; // Scopes up from the one it's evaluated in,filled in by the resolver(see resolver.h).
+    size_t slot;
 } Identifier;
 
 typedef struct
@@ -47,8 +60,62 @@ typedef struct
 {
     struct Expr *assigne; // E.g: x.y = 3 => both assigne and value have to be expressions.
     struct Expr *value;
+    char *op; // NULL for =,otherwise the operator of a compound assignment("+" for +=).
 } AssignmentExpr;
 
+typedef struct
+{
+    struct Expr **elements;
+    size_t len;
+} ArrayLiteral;
+
+typedef struct
+{
+    struct Expr *target;
+    struct Expr *index;
+} IndexExpr;
+
+typedef struct
+{
+    char *callee; // Only builtins can be called,so just a name.
+    struct Expr **args;
+    size_t argc;
+    const void *builtin; // The Builtin callee names,looked up on the first call.
+} CallExpr;
+
+typedef struct
+{
+    struct Expr **keys;
+    struct Expr **values;
+    size_t len;
+} MapLiteral;
+
+#define MEMBER_CACHE_SIZE 4
+
+typedef struct
+{
+    struct Expr *object;
+    char *property;
+    uint64_t cache[MEMBER_CACHE_SIZE]; // Inline cache of (shape,slot),filled in by the interpreter(see record.h).
+} MemberExpr;
+
+typedef struct
+{
+    char **names;
+    struct Expr **values;
+    size_t len;
+    void *shape; // Shape of the records it builds,cached on first evaluation.
+} RecordLiteral;
+
+typedef struct
+{
+    char **parts; // The nholes + 1 literal pieces around the holes,any of them can be empty.
+    size_t *partlens;
+    struct Expr **holes;
+    size_t nholes;
+    size_t literal_length; // Sum of partlens.
+} TemplateLiteral;
+
 struct Expr
 {
     ExprType kind;
@@ -60,6 +127,13 @@ struct Expr
         UnaryExpr ue;
         BinaryExpr be;
         AssignmentExpr a;
+        ArrayLiteral arr;
+        IndexExpr idx;
+        CallExpr call;
+        MapLiteral map;
+        MemberExpr mem;
+        RecordLiteral rec;
+        TemplateLiteral tpl;
     } data;
 };
 typedef struct Expr Expr;
@@ -75,6 +149,7 @@ typedef struct
     char *ident;
     Expr *value;
     int isConst;
+    size_t slot; // In the scope it declares into,VAR_UNRESOLVED until resolved.
 } VariableDeclarationStmt;
 
 struct Stmt
@@ -95,13 +170,24 @@ typedef struct
     size_t cap;
 } Program;
 
-Expr *make_expr_numeric(int n);
+Expr *make_expr_numeric(int64_t n);
+Expr *make_expr_numeric_digits(char *digits);
 Expr *make_expr_string(char *s);
 Expr *make_expr_ident(char *symbol);
 
 Expr *make_expr_unary(Expr *on, char op);
 Expr *make_expr_binary(Expr *left, Expr *right, char *op);
-Expr *make_expr_assignment(Expr *assigne,Expr *value);
+Expr *make_expr_assignment(Expr *assigne,Expr *value,char *op); // op is copied,NULL for plain =.
+
+Expr *make_expr_array(Expr **elements, size_t len); // Takes over elements.
+Expr *make_expr_index(Expr *target, Expr *index);
+Expr *make_expr_call(char *callee, Expr **args, size_t argc); // Copies callee,takes over args.
+Expr *make_expr_map(Expr **keys, Expr **values, size_t len); // Takes over keys and values.
+Expr *make_expr_member(Expr *object, char *property); // Copies property.
+Expr *make_expr_record(char **names, Expr **values, size_t len); // Takes over names and values.
+Expr *make_expr_template(char **parts, Expr **holes, size_t nholes); // Takes over parts and holes.
+
+Expr *clone_expr(Expr *expr); // Deep copy,for when an expression has to outlive its Program.
 
 Stmt *make_stmt_expr_stmt(Expr *expr);
 Stmt *make_stmt_var_decl_stmt(char *ident, Expr *value, int isConst);
@@ -8,6 +8,7 @@ typedef enum
     */
     TOKENTYPE_Number,
     TOKENTYPE_String,
+    TOKENTYPE_Template, // A string with ${...} holes in it,holes still unparsed.
     TOKENTYPE_Identifier,
 
     /*
@@ -17,10 +18,17 @@ typedef enum
     TOKENTYPE_UnaryOperator,
 
     /*
-    Parenthesis(/Brackets/Braces in the future)
+    Parenthesis/Brackets/Braces
     */
     TOKENTYPE_OpenParen,
     TOKENTYPE_CloseParen,
+    TOKENTYPE_OpenBracket,
+    TOKENTYPE_CloseBracket,
+    TOKENTYPE_OpenBrace,
+    TOKENTYPE_CloseBrace,
+    TOKENTYPE_Comma,
+    TOKENTYPE_Colon,
+    TOKENTYPE_Dot,
     
     /*
     Variables
@@ -28,6 +36,7 @@ typedef enum
     TOKENTYPE_Let,
     TOKENTYPE_Const,
     TOKENTYPE_Equals,
+    TOKENTYPE_CompoundAssignment, // +=,<<=,etc.
     
     /*
     Enders
@@ -52,6 +61,11 @@ typedef struct
 //TODO: move my_str_dup into strutils or something.
 char *my_str_dup(const char *str);
 
+// src points just past the opening ",returns the closing " or the NUL if there is none.Sets *holes if it saw a ${.
+const char *string_end(const char *src, int *holes);
+// src points just past a ${,returns its closing } or the NUL if there is none.Braces and strings inside nest.
+const char *template_hole_end(const char *src);
+
 int is_unop(char c);
 int is_binop(char c);
 int is_alpha(char c);
@@ -24,9 +24,14 @@ Stmt *parse_var_decl_stmt(Parser *p);
 
 Expr *parse_expr(Parser *p);
 Expr *parse_assignment_expr(Parser *p);
+Expr *parse_bitwise_or_expr(Parser *p);
+Expr *parse_bitwise_xor_expr(Parser *p);
+Expr *parse_bitwise_and_expr(Parser *p);
 Expr *parse_comparision_expr(Parser *p);
+Expr *parse_shift_expr(Parser *p);
 Expr *parse_additive_expr(Parser *p);
 Expr *parse_multiplicative_expr(Parser *p);
 Expr *parse_unary_expr(Parser *p);
+Expr *parse_postfix_expr(Parser *p);
 Expr *parse_primary_expr(Parser *p);
 #endif
\ No newline at end of file
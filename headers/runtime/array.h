@@ -0,0 +1,36 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+#include <stddef.h>
+#include "runtime/values.h"
+
+/*
+Arrays are immutable,refcounted and hold unboxed doubles in one ARRAY_ALIGN aligned buffer.
+Arithmetic between two arrays(of the same length) or an array and a number works elementwise,
+and it and the reductions below run on SSE2/AVX vectors when the target has them.
+Integers are converted to double on the way in,so a[i] always reads back a number.
+*/
+
+#define ARRAY_ALIGN 64
+
+typedef struct
+{
+    Obj obj;
+    size_t length;
+    double *data;
+} ArrayObj;
+
+ArrayObj *array_alloc(size_t length); // Refcount 1,caller fills data[0..length).
+RuntimeVal runtimeval_array(ArrayObj *arr); // Takes over the caller's reference.
+
+RuntimeVal array_binary(RuntimeVal left, RuntimeVal right, char *op); // At least one side is an array.Borrows both.
+RuntimeVal array_negate(const ArrayObj *arr);
+bool array_equals(const ArrayObj *a, const ArrayObj *b);
+
+double array_sum(const ArrayObj *arr);
+double array_min(const ArrayObj *arr); // Both error on an empty array.
+double array_max(const ArrayObj *arr);
+double array_dot(const ArrayObj *a, const ArrayObj *b);
+
+void dump_array(const ArrayObj *arr);
+void free_array(ArrayObj *arr);
+#endif
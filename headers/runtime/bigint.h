@@ -0,0 +1,33 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "runtime/values.h"
+
+/*
+Integers that do not fit int64_t.Integer arithmetic that overflows promotes to a BigIntObj instead of a double,
+and any result that fits int64_t again goes back to the inline/boxed integer,so a BigIntObj is never
+in int64_t range.Sign and magnitude,the magnitude in 64 bit limbs.
+Multiplication switches to Karatsuba above KARATSUBA_THRESHOLD limbs,division is Knuth's algorithm D.
+Bitwise operators act on the infinite two's complement representation,like they do on int64_t.
+*/
+
+#define KARATSUBA_THRESHOLD 32 // Limbs,below this schoolbook multiplication wins.
+
+struct BigIntObj
+{
+    Obj obj;
+    bool negative;
+    size_t length; // Limbs,the most significant one is never 0.
+    uint64_t limbs[]; // Magnitude,least significant first.
+};
+typedef struct BigIntObj BigIntObj;
+
+RuntimeVal bigint_binary(RuntimeVal left, RuntimeVal right, char *op); // Either side may be a plain integer.Borrows both.
+RuntimeVal bigint_negate(RuntimeVal val); // Also takes plain integers,for -INT64_MIN.Borrows val.
+RuntimeVal bigint_not(RuntimeVal val); // ~val.Borrows val.
+
+RuntimeVal bigint_from_decimal(const char *digits);
+RuntimeVal bigint_from_double(double d); // d must be finite and integral.
+char *bigint_to_decimal(const BigIntObj *big); // In scratch memory,between the caller's scratch_mark and scratch_release.
+#endif
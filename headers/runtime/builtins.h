@@ -0,0 +1,35 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "frontend/ast.h"
+
+/*
+Builtin functions,the only things a CallExpr can call.
+Arguments are evaluated left to right before the call and freed after it,so builtins borrow them.
+Builtins that take an expression(map,filter...) have a form instead,which gets the arguments unevaluated.
+Math builtins(sqrt,pow...) carry the C function itself,see mathlib.h.
+*/
+
+typedef RuntimeVal (*BuiltinFn)(RuntimeVal *args, size_t argc);
+typedef RuntimeVal (*BuiltinFormFn)(Expr **args, size_t argc, Scope *scope);
+typedef double (*MathFn1)(double);
+typedef double (*MathFn2)(double, double);
+typedef void (*MathKernel)(double *out, const double *in, size_t n); // MathFn1 over a whole array.
+
+typedef struct
+{
+    const char *name;
+    size_t arity;
+    BuiltinFn fn;
+    BuiltinFormFn form; // Used instead of fn when set.
+    int writes; // Assigns to the variable passed as its first argument.
+    MathFn1 unary; // Math builtins,called directly instead of through fn.
+    MathFn2 binary;
+    MathKernel kernel; // Optional,unary is used element by element without one.
+    size_t binds; // How many arguments after the first are names,bound in a scope of their own for the last one.
+} Builtin;
+
+const Builtin *find_builtin(const char *name); // NULL when there is no such builtin.
+#endif
@@ -0,0 +1,27 @@
+#ifndef COLLECTIONS_H
+#define COLLECTIONS_H
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "frontend/ast.h"
+
+/*
+Bulk builtins over arrays,run on the thread pool:
+  map(a, x, expr)       array of expr for every element x of a
+  filter(a, x, cond)    the elements for which cond is true,in order
+  reduce(a, l, r, expr) folds with an associative expr,erroring on an empty array
+  sort(a)               ascending,-0 before 0 and NaNs last
+Inputs are cut into COLLECTION_CHUNK element chunks which the pool's threads steal from each other.
+An expression only runs in parallel when it cannot fail(see expr_is_total),otherwise the chunks run
+in order on the calling thread,so the first error is the one sequential evaluation would report.
+Chunk boundaries never depend on the thread count,so reduce groups its operands the same way on
+every machine and the results are identical.Arrays of a single chunk skip the pool altogether.
+*/
+
+#define COLLECTION_CHUNK 4096 // Elements per task.
+
+RuntimeVal collection_map(Expr **args, size_t argc, Scope *scope);
+RuntimeVal collection_filter(Expr **args, size_t argc, Scope *scope);
+RuntimeVal collection_reduce(Expr **args, size_t argc, Scope *scope);
+RuntimeVal collection_sort(RuntimeVal *args, size_t argc);
+#endif
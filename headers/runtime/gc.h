@@ -0,0 +1,21 @@
+#ifndef GC_H
+#define GC_H
+#include <stddef.h>
+#include "runtime/values.h"
+
+/*
+Freeing heap objects.Values can't form cycles(a container is copied before a write while it is shared,
+so it never ends up inside itself),so reference counting alone reclaims everything.
+An object whose count reaches 0 isn't freed recursively:maps,records and ropes go on a per-thread
+queue and freeing one queues the containers inside it,so dropping a value nested a million levels deep
+can't overflow the C stack.The queue is drained on the spot,at most budget objects at a time on a
+thread that set one(the REPL with --gc-budget),and what's left is freed by later drains and gc_step.
+*/
+
+#define GC_UNLIMITED 0
+
+void gc_set_budget(size_t budget); // For the calling thread.GC_UNLIMITED,the default,frees everything at once.
+void gc_release(Obj *obj); // obj's count just reached 0.
+void gc_step(void); // Frees up to a budget's worth of the queue,called between statements.
+void gc_drain(void); // Frees everything queued on the calling thread.
+#endif
@@ -14,13 +14,31 @@ RuntimeVal eval_expr(Expr *expr, Scope *scope);
 RuntimeVal eval_unary_expr(UnaryExpr ue,Scope *scope);
 
 RuntimeVal eval_binary_expr(BinaryExpr be, Scope *scope);
+RuntimeVal eval_binary_values(RuntimeVal left, RuntimeVal right, char *op); // Consumes both operands.
 
+bool values_equal(RuntimeVal left, RuntimeVal right); // == for entries of maps and records,where null equals null.Borrows both.
+
+int double_to_int64(double d, int64_t *out); // Only succeeds for integral values in range.
+
+RuntimeVal eval_integer_binary_expr(IntegerVal left, IntegerVal right, char *op);
 RuntimeVal eval_numeric_binary_expr(NumberVal left, NumberVal right, char *op);
-RuntimeVal eval_string_binary_expr(StringVal left, StringVal right, char *op);
+RuntimeVal eval_string_binary_expr(RuntimeVal left, RuntimeVal right, char *op); // Borrows both.
 RuntimeVal eval_bool_binary_expr(BoolVal left, BoolVal right, char *op);
 
-RuntimeVal eval_numeric_string_binary_expr(NumberVal left, StringVal right, char *op);
+RuntimeVal eval_numeric_string_binary_expr(NumberVal left, RuntimeVal right, char *op); // Borrows right.
 RuntimeVal eval_numeric_bool_expr(NumberVal left, BoolVal right, char *op);
 
 RuntimeVal eval_assignment_expr(AssignmentExpr a, Scope *scope);
+
+// The map or record bound to var,ready to be written.If it is shared(or constant,or a reactive binding) it is a copy,
+// returned in *fresh as well,and the caller must setvar it afterwards.Otherwise *fresh is null.
+Obj *obj_for_update(Scope *scope, Identifier *var, ObjType kind, RuntimeVal *fresh);
+
+RuntimeVal eval_array_literal(ArrayLiteral arr, Scope *scope);
+RuntimeVal eval_index_expr(IndexExpr idx, Scope *scope);
+RuntimeVal eval_call_expr(CallExpr *call, Scope *scope);
+RuntimeVal eval_map_literal(MapLiteral lit, Scope *scope);
+RuntimeVal eval_record_literal(RecordLiteral *lit, Scope *scope); // By pointer,the node caches its shape.
+RuntimeVal eval_template_literal(TemplateLiteral tpl, Scope *scope);
+RuntimeVal eval_member_expr(MemberExpr *mem, Scope *scope); // By pointer,the node holds the inline cache.
 #endif
\ No newline at end of file
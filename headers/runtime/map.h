@@ -0,0 +1,50 @@
+#ifndef MAP_H
+#define MAP_H
+#include <stddef.h>
+#include <stdint.h>
+#include "runtime/values.h"
+
+/*
+Maps from strings,numbers and booleans to any value.An open addressing table in the style of SwissTable:
+one control byte per slot,MAP_EMPTY or the low 7 bits of the key's hash,scanned MAP_GROUP_WIDTH at a time
+with one SSE2 compare when available,so most lookups touch a single group and compare a single key.
+Probing is linear,one group after the next,which lets deletion shift later entries back instead of
+leaving tombstones,so a table never fills up with dead slots however many keys come and go.
+The first MAP_GROUP_WIDTH control bytes are mirrored past the end,so a group can start at any slot.
+Integral numbers are stored as integers,so m[2] and m[4/2] are the same entry.
+A map is shared like every other value and copied the first time it is written while shared.
+*/
+
+#define MAP_GROUP_WIDTH 16
+#define MAP_MIN_CAPACITY 16 // Never less than MAP_GROUP_WIDTH.
+#define MAP_EMPTY 0x80
+#define MAP_MAX_LOAD_NUM 7 // Grows past 7/8 full.
+#define MAP_MAX_LOAD_DEN 8
+
+typedef struct
+{
+    RuntimeVal key;
+    RuntimeVal value;
+} MapSlot;
+
+struct MapObj
+{
+    Obj obj;
+    size_t length;
+    size_t capacity; // Power of two.
+    uint8_t *ctrl; // capacity + MAP_GROUP_WIDTH bytes.
+    MapSlot *slots;
+};
+typedef struct MapObj MapObj;
+
+MapObj *map_alloc(size_t length); // Empty,with room for length entries.
+MapObj *map_copy(const MapObj *map);
+RuntimeVal runtimeval_map(MapObj *map); // Takes over the caller's reference.
+
+RuntimeVal *map_find(const MapObj *map, RuntimeVal key); // NULL when key is missing.Borrows key.
+void map_set(MapObj *map, RuntimeVal key, RuntimeVal value); // Borrows key,takes over value.
+bool map_delete(MapObj *map, RuntimeVal key); // Borrows key.
+
+void dump_map(const MapObj *map);
+void free_map(MapObj *map);
+#endif
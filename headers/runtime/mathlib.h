@@ -0,0 +1,28 @@
+#ifndef MATHLIB_H
+#define MATHLIB_H
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/builtins.h"
+
+/*
+The math builtins(sqrt,exp,sin,pow...).A call to one skips the generic builtin call:the argument is
+handed straight to the C function as a double,without building an argument array.
+Given an array they run over every element,through an SSE2 kernel where there is one.
+exp,log,sin and cos kernels are polynomials that agree with libm to within a couple of ulps,
+lanes outside the range they are accurate for(huge,tiny,NaN...) are handed to libm instead.
+*/
+
+void math_kernel_sqrt(double *out, const double *in, size_t n);
+void math_kernel_abs(double *out, const double *in, size_t n);
+void math_kernel_floor(double *out, const double *in, size_t n);
+void math_kernel_ceil(double *out, const double *in, size_t n);
+void math_kernel_trunc(double *out, const double *in, size_t n);
+void math_kernel_round(double *out, const double *in, size_t n);
+void math_kernel_exp(double *out, const double *in, size_t n);
+void math_kernel_log(double *out, const double *in, size_t n);
+void math_kernel_sin(double *out, const double *in, size_t n);
+void math_kernel_cos(double *out, const double *in, size_t n);
+
+RuntimeVal math_call1(const Builtin *builtin, RuntimeVal arg); // Consumes arg.
+RuntimeVal math_call2(const Builtin *builtin, RuntimeVal left, RuntimeVal right); // Consumes both.
+#endif
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "frontend/ast.h"
+
+/*
+Top-level statements that neither assign nor can fail are evaluated on the thread pool
+whenever nothing earlier in the program still has to write a variable they read.
+Declarations are still committed to the scope strictly in program order,so the last value,
+declaration order and the first error reported are exactly what sequential evaluation gives.
+*/
+
+int expr_is_pure(Expr *expr); // No assignment anywhere inside.
+int stmt_is_pure(Stmt *stmt);
+int expr_is_total(Expr *expr, Scope *scope); // Can be evaluated against scope without erroring.
+
+size_t parallel_segment_end(Program prog, size_t start); // End of the run of pure statements starting at start.
+RuntimeVal eval_segment_parallel(Program prog, size_t start, size_t end, Scope *scope);
+#endif
@@ -0,0 +1,56 @@
+#ifndef REACTIVE_H
+#define REACTIVE_H
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "frontend/ast.h"
+
+/*
+Reactive mode(--reactive):a `let` whose initializer reads variables becomes a derived binding.
+The variables read while evaluating it are recorded,setvar marks everything downstream dirty,
+and a dirty binding is only recomputed when it is next read.Assigning to a derived binding
+turns it back into a plain one.
+
+Lazy mode(--lazy):a `let` whose initializer has no assignment stores a thunk instead of a value
+and the declaration itself evaluates to null.The thunk is forced on first read and the result cached.
+It always sees the values its variables had at the point of declaration,because assigning to a
+variable first forces every pending thunk that reads it.An error in the initializer is reported
+on first read,with the name of the binding being forced,and never if the binding is never read.
+Assigning to a binding before its first read discards its initializer.
+*/
+
+struct Cell
+{
+    Scope *scope; // Where the binding lives,and where expr is evaluated.
+    size_t idx;
+    Expr *expr; // Owned clone of the initializer,NULL for a plain binding that others depend on.
+    int dirty;
+    int lazy; // Thunk:evaluated at most once,then the cell is a plain binding.
+    struct Cell **deps;
+    size_t depslen;
+    size_t depscap;
+    struct Cell **depset; // The same cells hashed,once there are too many to scan.NULL until then,or when out of date.
+    size_t depsetcap;
+    struct Cell **dependents;
+    size_t dependentslen;
+    size_t dependentscap;
+};
+typedef struct Cell Cell;
+
+extern int reactive_enabled;
+extern int lazy_enabled;
+
+Cell *cell_of(Scope *scope, size_t idx); // Creates the cell if the binding has none.
+
+void cell_track_read(Scope *scope, size_t idx); // Called by getvar,records a dependency of the cell being evaluated.
+void cell_invalidate(Cell *cell); // Marks everything that depends on cell dirty.
+void cell_refresh(Cell *cell); // Recomputes a dirty derived binding into its slot.
+void cell_detach(Cell *cell); // Forgets the formula,cell becomes a plain binding.
+void cell_force_thunks(Cell *cell); // Forces the pending thunks reading cell,before it is written.
+void cell_release(Cell *cell); // Unlinks a plain binding from its dependents,before its (temporary) scope is freed.
+
+RuntimeVal declare_derived(Scope *scope, char *varname, Expr *expr, int isconst);
+RuntimeVal declare_lazy(Scope *scope, char *varname, Expr *expr, int isconst);
+
+void free_cell(Cell *cell);
+#endif
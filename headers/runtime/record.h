@@ -0,0 +1,49 @@
+#ifndef RECORD_H
+#define RECORD_H
+#include <stddef.h>
+#include <stdint.h>
+#include "runtime/values.h"
+
+/*
+Records,{x = 1, y = 2},with fields read as r.x and added or written with r.x = v.
+A record's field names live in its Shape,shared by every record built by adding the same fields
+in the same order,and the record itself is just the shape plus an array of values.Shapes form a
+transition tree from the empty shape:adding a field moves to the child for that name,so shapes are
+created once and never freed.Every r.x node has an inline cache of up to MEMBER_CACHE_SIZE
+(shape,slot) pairs,so in hot code a field access is a shape compare and an indexed load and the
+names are only searched on a miss.
+*/
+
+typedef struct Shape
+{
+    uint32_t id; // Never 0,which marks an empty cache entry.
+    struct Shape *parent;
+    size_t nfields;
+    char **names; // In slot order,the last one is the field this shape added.
+    struct Shape **children;
+    size_t nchildren;
+    size_t childcap;
+} Shape;
+
+typedef struct
+{
+    Obj obj;
+    Shape *shape;
+    size_t capacity;
+    RuntimeVal *slots; // shape->nfields of them are set.
+} RecordObj;
+
+Shape *shape_root(void);
+Shape *shape_with(Shape *shape, char *name); // The child adding name.Thread safe.
+
+RecordObj *record_alloc(Shape *shape); // Refcount 1,caller fills slots[0..shape->nfields).
+RecordObj *record_copy(const RecordObj *rec);
+RuntimeVal runtimeval_record(RecordObj *rec); // Takes over the caller's reference.
+
+// cache is the MEMBER_CACHE_SIZE entries of the MemberExpr doing the access.
+RuntimeVal *record_field(const RecordObj *rec, char *name, uint64_t *cache); // NULL when there's no such field.
+void record_set(RecordObj *rec, char *name, RuntimeVal value, uint64_t *cache); // Adds the field if missing.Takes over value.
+
+void dump_record(const RecordObj *rec);
+void free_record(RecordObj *rec);
+#endif
@@ -0,0 +1,17 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+#include "runtime/scope.h"
+#include "frontend/ast.h"
+
+/*
+Runs over a Program before it is evaluated in scope,giving every Identifier the (depth,slot) of the variable
+it names and every declaration the slot it will declare into.Evaluation then indexes the values of the
+right scope directly instead of hashing the name in each scope up the parent chain.
+Only top-level declarations add variables,and map/filter/reduce bind their names in a scope of their own,
+so the layout of every scope an expression can see is known before anything runs.
+Unresolvable names,redeclarations and assignments to constants are reported here,before the program runs.
+That includes --lazy initializers,which can only read variables declared before them,as in strict mode.
+*/
+
+void resolve_program(Program prog, Scope *scope);
+#endif
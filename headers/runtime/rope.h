@@ -0,0 +1,43 @@
+#ifndef ROPE_H
+#define ROPE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "runtime/values.h"
+
+/*
+Long strings built with + and * are ropes:immutable trees whose leaves are ordinary strings.
+A concat node joins two strings,a repeat node stands for count copies of one string,
+so neither operation copies any bytes and "x" * 1000000000 is a single small node.
+Concat trees are kept AVL balanced(heights differ by at most one),so appending in a loop
+costs O(log n) new nodes,and small pieces appended at the edge are merged into the leaf there.
+A rope is flattened into a StringObj only when something needs contiguous bytes
+(printing,==,hashing),and the flat copy is cached in the node.
+Ropes carry VAL_TAG_STRING like flat heap strings,they are told apart by obj.kind.
+*/
+
+#define ROPE_FLAT_MAX 512 // Results up to this long are copied flat,and leaves merge up to it.
+
+typedef enum
+{
+    ROPE_Concat,
+    ROPE_Repeat,
+} RopeKind;
+
+struct RopeObj
+{
+    Obj obj;
+    size_t length;
+    RopeKind kind;
+    uint32_t height; // Leaves(flat strings and repeat nodes) are 0.
+    RuntimeVal left; // Repeat:the repeated string.
+    RuntimeVal right; // Concat only.
+    size_t count; // Repeat only.
+    StringObj *flat; // Contiguous copy,set on first flatten.
+};
+typedef struct RopeObj RopeObj;
+
+RuntimeVal string_concat(RuntimeVal left, RuntimeVal right); // Borrows both.
+RuntimeVal string_repeat(RuntimeVal str, size_t count); // Borrows str.
+
+void free_rope(RopeObj *rope);
+#endif
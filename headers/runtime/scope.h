@@ -2,28 +2,88 @@
 #define SCOPE_H
 #include <stddef.h> //Not sure why,but the preivously needed for size_t is not needed here acc. to vs code idk why???...
 #include "runtime/values.h"
+#include "frontend/ast.h"
+struct Cell;
+struct Shadow;
+
+#define FRAME_SLOTS 8 // What a new scope starts with,it doubles from there.
+#define SEGMENT_SLOTS 4096
+
+/*
+Scopes take their slots from a per-thread stack,a frame of FRAME_SLOTS keys and values each,
+so making and freeing one is a bump of the stack top and nothing else.Scopes must be freed in the
+opposite order they were made,on the thread that made them.A scope that fills up grows in place while
+it's the innermost one,and moves its slots to the heap otherwise(or once a segment is full).
+*/
+typedef struct ScopeSegment
+{
+    struct ScopeSegment *below;
+    size_t top;
+    char *keys[SEGMENT_SLOTS];
+    RuntimeVal values[SEGMENT_SLOTS];
+    unsigned char isconst[SEGMENT_SLOTS];
+} ScopeSegment;
+
 struct Scope
 {
-    char **keys;
+    char **keys; // Into the frame,or the heap once outgrown.
     RuntimeVal *values;
-    char **constants;
+    unsigned char *isconst;
+    struct Cell **cells; // Parallel to values,NULL until some binding in this scope needs one(see reactive.h).
+    size_t *index; // Open addressing over keys,slot+1 or 0 for empty.NULL while there are few enough keys to scan.
+    size_t indexcap;
     size_t len;
     size_t cap;
-    size_t constantslen;
-    size_t constantscap;
     struct Scope *parent;
+    ScopeSegment *frame; // NULL once frozen.
+    size_t framebase;
+    size_t framecap;
+    int frozen;
+    int forked; // Made by fork_scope,holds a reference to its parent.
+    size_t refcount; // Of a frozen scope.
+    struct Shadow *shadows; // Of a fork,which of its slots are copies of frozen ones.
+    size_t shadowslen;
+    size_t shadowscap;
+    void *mapping; // Of a frozen scope read from a snapshot,the file its keys and values live in.
+    size_t mapsize;
 };
 typedef struct Scope Scope;
 
 int resolve(Scope *scope, char *varname, Scope **out_scope, size_t *out_idx);
+int is_constant(Scope *scope, char *varname); // Only looks at scope itself,not its parents.
+size_t find_var(Scope *scope, const char *varname); // Slot in scope itself,VAR_UNRESOLVED when it isn't there.
+int is_declared(Scope *scope, const char *varname); // In scope itself,or for a fork in the scopes it was forked from.
 
 RuntimeVal declarevar(Scope *scope, char *varname, RuntimeVal value, int isconst);
 RuntimeVal getvar(Scope *scope, char *varname);
 RuntimeVal setvar(Scope *scope, char *varname, RuntimeVal value);
 
+// Variables the resolver gave an address are found by walking up var->depth scopes,the rest by name.
+// Redeclaration and constness of resolved ones were checked by the resolver,so these don't check again.
+Scope *locate(Scope *scope, Identifier *var, size_t *out_idx); // Exits when var can't be resolved.
+Scope *locate_write(Scope *scope, Identifier *var, size_t *out_idx); // The same,but never a frozen scope.
+RuntimeVal getvar_id(Scope *scope, Identifier *var);
+RuntimeVal setvar_id(Scope *scope, Identifier *var, RuntimeVal value);
+RuntimeVal declarevar_at(Scope *scope, size_t slot, char *varname, RuntimeVal value, int isconst); // slot must be the next one.
+
 void init_scope(Scope *scope);
 void init_global_scope(Scope *scope);
 
 Scope new_scope(Scope *parent);
 void free_scope(Scope *scope);
+
+/*
+A populated scope can be frozen and then forked any number of times,e.g. once per session over a shared prelude.
+A fork is an empty scope whose parent is the frozen one,so making it is O(1),and it reads frozen variables in place.
+The first write to one copies just that binding into the fork,where every later read and write in the fork finds it.
+Frozen scopes are never written,so forks can run on different threads.Each fork holds a reference to its parent.
+A fork can't redeclare a variable of the scopes it was forked from,as if it were a copy of them.
+Not for reactive or lazy bindings,whose cells are updated in place.
+*/
+Scope *freeze_scope(Scope *scope); // Takes over scope,which must be the innermost scope on this thread.
+Scope fork_scope(Scope *frozen);
+// A frozen scope over slots in a mapped file(see snapshot.h),which is unmapped when it is released.
+Scope *freeze_mapped(char **keys, RuntimeVal *values, unsigned char *isconst, size_t len, void *mapping, size_t mapsize);
+void release_scope(Scope *frozen); // Drops the reference freeze_scope returned.
+Scope *shadowed(Scope *scope, Scope *frozen, size_t *idx, int create); // The fork's copy of frozen's slot *idx,seen from scope.
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef SCRATCH_H
+#define SCRATCH_H
+#include <stddef.h>
+
+/*
+Per-thread bump region for buffers that only live while an expression is evaluated:bigint limbs
+before they are copied into the result,Karatsuba and division temporaries,digits being formatted,
+match positions,the per-chunk buffers of map/filter/reduce/sort.
+No RuntimeVal ever points in here(results are copied out),so nothing has to be promoted when a value escapes.
+Space is given back in LIFO order with scratch_mark/scratch_release,and eval_program calls scratch_reset
+after every top-level statement,which also frees what a statement needed beyond one SCRATCH_BLOCK.
+Once the region has warmed up,expression evaluation doesn't call malloc for any of these.
+*/
+
+#define SCRATCH_BLOCK (64 * 1024)
+
+typedef struct
+{
+    size_t block;
+    size_t used;
+} ScratchMark;
+
+void *scratch_alloc(size_t size); // 16 byte aligned,exits when out of memory.
+ScratchMark scratch_mark(void);
+void scratch_release(ScratchMark mark); // Everything allocated since mark is gone.
+void scratch_reset(void); // Only with nothing allocated on this thread still in use.
+#endif
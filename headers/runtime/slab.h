@@ -0,0 +1,31 @@
+#ifndef SLAB_H
+#define SLAB_H
+#include <stddef.h>
+
+/*
+Allocator for runtime objects(strings,boxed integers,ropes,maps...) and scope keys.
+Requests up to SLAB_MAX bytes are rounded up to a size class and served from a per-thread free list,
+no lock and no search.A thread that frees far more than it allocates(a pool thread dropping
+a parallel map's temporaries) hands blocks back to a global pool SLAB_BATCH at a time,and a thread that
+runs dry takes a batch from there before carving a new chunk out of malloc.Chunks are kept for reuse
+and never returned to the system.Bigger requests go to malloc.
+Blocks are 8 byte aligned and start with their size class,so slab_free doesn't need the size.
+Build with -DVALEX_NO_SLAB to use malloc for everything,so ASan or valgrind see every object.
+*/
+
+#define SLAB_MAX 1016 // Largest request served from a size class.
+#define SLAB_BATCH 32
+
+#ifdef VALEX_NO_SLAB
+#include <stdlib.h>
+#define slab_alloc malloc
+#define slab_realloc realloc
+#define slab_free free
+#else
+void *slab_alloc(size_t size); // NULL when out of memory,like malloc.
+void *slab_realloc(void *ptr, size_t size);
+void slab_free(void *ptr);
+#endif
+
+char *slab_strdup(const char *str); // NULL when out of memory.
+#endif
@@ -0,0 +1,22 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "runtime/scope.h"
+
+/*
+A snapshot is a scope's variables written to a file,so a session can start from a populated global scope
+without evaluating anything.Every object the values reach is laid out in the file in its in-memory
+form(ropes and slices are flattened into strings,shared objects are written once) with pointers
+stored relative to SNAPSHOT_BASE,and a table lists every word that holds one.
+Reading maps the file private and copy-on-write:when it lands at SNAPSHOT_BASE nothing is touched,
+otherwise the listed words are moved by the difference.Records get their shapes back by adding
+their field names from shape_root.The objects have a refcount no session can bring down to 0,so
+they are never freed or written in place:the first write to one copies it,like any shared value.
+A snapshot is only readable by the build that wrote it.
+*/
+
+#define SNAPSHOT_BASE 0x200000000000ULL // Where the file would like to be mapped.
+#define SNAPSHOT_REFCOUNT (UINT32_C(1) << 31) // Of every object in a snapshot.
+
+void snapshot_write(Scope *scope, const char *path); // The variables of scope itself,not of its parents.
+Scope *snapshot_read(const char *path); // Frozen(see scope.h),the file stays mapped until it is released.
+#endif
@@ -0,0 +1,25 @@
+#ifndef TEXT_H
+#define TEXT_H
+#include <stddef.h>
+#include "runtime/values.h"
+
+/*
+Substring search and the string builtins built on it(find,contains,count,split,replace,starts_with).
+Candidates are found a block at a time by comparing the first and the last byte of the needle
+against the haystack at once(SSE2,or AVX2 when the compiler targets it),and only those get a memcmp.
+Inputs where that keeps finding false candidates("aaaa...b" in "aaaa...") switch to two-way,
+which is linear in the worst case,and so is every search on targets without SIMD.
+Pieces cut out of a string are slices:views that keep the original alive instead of copying it.
+*/
+
+#define SLICE_MIN 64 // Shorter pieces are copied,a slice costs about as much and would pin the whole string.
+
+#define TEXT_NOT_FOUND ((size_t)-1)
+
+size_t text_find(StringVal hay, StringVal needle); // TEXT_NOT_FOUND when missing.
+size_t text_count(StringVal hay, StringVal needle); // Non-overlapping.
+RuntimeVal text_split(RuntimeVal str, StringVal sep); // Borrows str.A map from 0,1,... to the pieces.
+RuntimeVal text_replace(RuntimeVal str, StringVal from, StringVal to); // Borrows str.
+
+RuntimeVal string_slice(RuntimeVal str, size_t start, size_t length); // Borrows str.
+#endif
@@ -0,0 +1,21 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <stddef.h>
+
+/*
+Work stealing:each thread starts with a contiguous slice of the task indices and takes from its front.
+A thread that runs out steals the back half of another thread's slice,so uneven tasks still keep every core busy.
+*/
+
+#define THREADPOOL_CACHE_LINE 64 // Per thread slices are padded to this,so neighbours don't share a line.
+
+typedef void (*TaskFn)(void *arg, size_t idx);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *threadpool_global(void); // Lazily started, sized from VALEX_THREADS or the number of online cores.
+size_t threadpool_size(ThreadPool *pool);
+
+// Runs fn(arg, 0..n-1) across the pool and blocks until every task is done.The calling thread works too.
+void threadpool_run(ThreadPool *pool, TaskFn fn, void *arg, size_t n);
+#endif
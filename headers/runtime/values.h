@@ -1,5 +1,7 @@
 #ifndef VALUES_H
 #define VALUES_H
+#include <stdint.h>
+#include <string.h>
 
 #ifndef bool
 #define bool _Bool
@@ -19,8 +21,53 @@ typedef enum
     VAL_Bool,
     VAL_String,
     VAL_Null,
+    VAL_Integer,
+    VAL_Array,
+    VAL_Map,
+    VAL_Record,
 } ValueType;
 
+typedef enum
+{
+    OBJ_Integer, // int64 that does not fit the 48 bit inline payload.
+    OBJ_String,
+    OBJ_Rope, // Unflattened string,see rope.h.Tagged like a heap string.
+    OBJ_BigInt, // Integer outside int64_t,see bigint.h.
+    OBJ_Array, // See array.h.
+    OBJ_Map, // See map.h.
+    OBJ_Record, // See record.h.
+    OBJ_Slice, // Substring of another heap string,see text.h.Tagged like a heap string.
+} ObjType;
+
+typedef struct
+{
+    uint32_t refcount; // Updated atomically,values are shared with the parallel evaluation threads.
+    ObjType kind;
+} Obj; // Header shared by every heap object a RuntimeVal can point to.
+
+typedef struct
+{
+    Obj obj;
+    size_t length;
+    size_t capacity; // Room in chars,not counting the NUL.Only a uniquely owned string may grow into it.
+    uint64_t hash; // 0 until string_hash computes it.
+    char chars[]; // Always NUL terminated.Immutable once shared.
+} StringObj;
+
+typedef struct
+{
+    Obj obj;
+    Obj *base; // The flat string or rope the bytes live in,the slice holds a reference to it.
+    const char *chars;
+    size_t length;
+} SliceObj;
+
+typedef struct
+{
+    Obj obj;
+    int64_t value;
+} IntegerObj;
+
 typedef struct
 {
     double value;
@@ -33,27 +80,192 @@ typedef struct
 
 typedef struct
 {
-    char *value;
-} StringVal;
+    const char *chars; // Not NUL terminated when the string is stored inline or is a slice.
+    size_t length;
+    StringObj *obj; // NULL for inline strings and slices.
+} StringVal; // Borrowed view of either string representation.
 
-typedef struct {
-    ValueType type;
-    union
-    {
-        NumberVal n;
-        BoolVal b;
-        StringVal s;
-    } data;
+typedef struct
+{
+    int64_t value;
+} IntegerVal;
+
+/*
+A RuntimeVal is a single NaN-boxed 64 bit word,so it always travels in a register.
+Every double is stored as itself,with all NaNs canonicalized to 0x7FF8000000000000.
+That leaves the negative quiet NaN space(top 16 bits 0xFFF9..0xFFFF) free for tags,
+with a 48 bit payload underneath,enough for a bool,a user-space pointer or a 48 bit integer.
+Integers that need the full 64 bits are boxed in an IntegerObj,anything bigger is a BigIntObj.
+Heap objects are refcounted:copy_value takes a reference,free_value drops one.
+Strings of up to 6 bytes never touch the heap,they live in the payload.
+Never touch .bits directly outside values.h/values.c,use the macros below.
+*/
+typedef struct
+{
+    uint64_t bits;
 } RuntimeVal;
 
+#define VAL_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+#define VAL_CANONICAL_NAN 0x7FF8000000000000ULL
+
+#define VAL_TAG_NULL 0xFFF9000000000000ULL
+#define VAL_TAG_BOOL 0xFFFA000000000000ULL
+#define VAL_TAG_INTEGER 0xFFFB000000000000ULL // Sign-extended 48 bit payload.
+#define VAL_TAG_OBJ 0xFFFC000000000000ULL
+#define VAL_TAG_STRING 0xFFFE000000000000ULL // Both string tags sit at the top,so VAL_IS_STRING is one compare.
+#define VAL_TAG_SHORT_STRING 0xFFFF000000000000ULL // Up to 6 bytes in the payload itself,NUL padded.
+
+#define VAL_SHORT_STRING_MAX 6
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Inline strings are read straight out of the payload bytes,which needs a little endian target."
+#endif
+
+#define VAL_INLINE_INT_MIN (-(INT64_C(1) << 47))
+#define VAL_INLINE_INT_MAX ((INT64_C(1) << 47) - 1)
+
+#define VAL_TAG(v) ((v).bits & ~VAL_PAYLOAD_MASK)
+
+#define VAL_IS_NUMBER(v) ((v).bits < VAL_TAG_NULL) // -inf is 0xFFF0...,the largest non-NaN pattern.
+#define VAL_IS_BOOL(v) (VAL_TAG(v) == VAL_TAG_BOOL)
+#define VAL_IS_STRING(v) ((v).bits >= VAL_TAG_STRING)
+#define VAL_IS_HEAP_STRING(v) (VAL_TAG(v) == VAL_TAG_STRING)
+#define VAL_IS_SHORT_STRING(v) (VAL_TAG(v) == VAL_TAG_SHORT_STRING)
+#define VAL_IS_NULL(v) ((v).bits == VAL_TAG_NULL)
+#define VAL_IS_SMALL_INTEGER(v) (VAL_TAG(v) == VAL_TAG_INTEGER)
+#define VAL_IS_OBJ(v) (VAL_TAG(v) == VAL_TAG_OBJ)
+#define VAL_IS_INTEGER(v) (VAL_IS_SMALL_INTEGER(v) || (VAL_IS_OBJ(v) && VAL_AS_OBJ(v)->kind == OBJ_Integer)) // Fits int64_t.
+#define VAL_IS_BIGINT(v) (VAL_IS_OBJ(v) && VAL_AS_OBJ(v)->kind == OBJ_BigInt)
+#define VAL_IS_ARRAY(v) (VAL_IS_OBJ(v) && VAL_AS_OBJ(v)->kind == OBJ_Array)
+#define VAL_IS_MAP(v) (VAL_IS_OBJ(v) && VAL_AS_OBJ(v)->kind == OBJ_Map)
+#define VAL_IS_RECORD(v) (VAL_IS_OBJ(v) && VAL_AS_OBJ(v)->kind == OBJ_Record)
+#define VAL_IS_ANY_INTEGER(v) (VAL_IS_INTEGER(v) || VAL_IS_BIGINT(v))
+#define VAL_IS_NUMERIC(v) (VAL_IS_NUMBER(v) || VAL_IS_ANY_INTEGER(v))
+
+#define VAL_TYPE(v) value_type(v)
+
+#define VAL_AS_NUMBER(v) value_bits_to_double((v).bits)
+#define VAL_AS_BOOL(v) ((bool)((v).bits & 1))
+#define VAL_AS_STRING_OBJ(v) ((StringObj *)(uintptr_t)((v).bits & VAL_PAYLOAD_MASK)) // Flat heap strings only.
+#define VAL_AS_STRING(vp) value_string_view(vp) // Takes a pointer,inline strings and slices are viewed in place.Flattens ropes.
+#define VAL_STRING_LENGTH(v) string_length(v) // O(1),never flattens.
+#define VAL_AS_OBJ(v) ((Obj *)(uintptr_t)((v).bits & VAL_PAYLOAD_MASK))
+#define VAL_AS_SMALL_INTEGER(v) ((int64_t)((v).bits << 16) >> 16)
+#define VAL_AS_INTEGER(v) (VAL_IS_SMALL_INTEGER(v) ? VAL_AS_SMALL_INTEGER(v) : ((IntegerObj *)VAL_AS_OBJ(v))->value) // Not for bigints.
+#define VAL_TO_DOUBLE(v) value_to_double(v) // Any numeric kind,bigints round.
+
+static inline double value_bits_to_double(uint64_t bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof d);
+    return d;
+}
+
+static inline ValueType value_type(RuntimeVal v)
+{
+    if (VAL_IS_NUMBER(v))
+        return VAL_Number;
+    switch (VAL_TAG(v))
+    {
+    case VAL_TAG_BOOL:
+        return VAL_Bool;
+    case VAL_TAG_STRING:
+    case VAL_TAG_SHORT_STRING:
+        return VAL_String;
+    case VAL_TAG_INTEGER:
+        return VAL_Integer;
+    case VAL_TAG_OBJ:
+        switch (VAL_AS_OBJ(v)->kind)
+        {
+        case OBJ_Integer:
+        case OBJ_BigInt:
+            return VAL_Integer;
+        case OBJ_Array:
+            return VAL_Array;
+        case OBJ_Map:
+            return VAL_Map;
+        case OBJ_Record:
+            return VAL_Record;
+        case OBJ_String:
+        case OBJ_Rope:
+        case OBJ_Slice:
+            return VAL_String;
+        }
+        return VAL_Null;
+    default:
+        return VAL_Null;
+    }
+}
+
+struct BigIntObj;
+double bigint_to_double(const struct BigIntObj *big);
+
+static inline double value_to_double(RuntimeVal v)
+{
+    if (VAL_IS_NUMBER(v))
+        return VAL_AS_NUMBER(v);
+    if (VAL_IS_BIGINT(v))
+        return bigint_to_double((const struct BigIntObj *)VAL_AS_OBJ(v));
+    return (double)VAL_AS_INTEGER(v);
+}
+
+struct RopeObj;
+StringObj *rope_flatten(struct RopeObj *rope); // Borrowed,the rope keeps the flat copy alive.
+
+static inline StringVal value_string_view(const RuntimeVal *v)
+{
+    StringVal view;
+    if (VAL_IS_SHORT_STRING(*v))
+    {
+        uint64_t payload = v->bits & VAL_PAYLOAD_MASK;
+        view.chars = (const char *)&v->bits; // Payload byte i is chars[i] on little endian.
+        view.length = payload ? (size_t)(63 - __builtin_clzll(payload)) / 8 + 1 : 0;
+        view.obj = NULL;
+        return view;
+    }
+    if (VAL_AS_OBJ(*v)->kind == OBJ_Slice)
+    {
+        const SliceObj *slice = (const SliceObj *)VAL_AS_OBJ(*v);
+        view.chars = slice->chars;
+        view.length = slice->length;
+        view.obj = NULL;
+        return view;
+    }
+    view.obj = VAL_AS_STRING_OBJ(*v);
+    if (view.obj->obj.kind == OBJ_Rope)
+        view.obj = rope_flatten((struct RopeObj *)view.obj);
+    view.chars = view.obj->chars;
+    view.length = view.obj->length;
+    return view;
+}
+
 RuntimeVal runtimeval_number(double val);
+RuntimeVal runtimeval_integer(int64_t val);
 RuntimeVal runtimeval_bool(bool b);
 RuntimeVal runtimeval_string(char *s);
+RuntimeVal runtimeval_string_len(const char *s, size_t length);
+RuntimeVal runtimeval_string_obj(StringObj *str); // Takes over the caller's reference.
+RuntimeVal runtimeval_obj(Obj *obj); // Same,for every other heap kind.
+
+StringObj *string_alloc(size_t length); // Refcount 1,caller fills chars[0..length).
+StringObj *string_reserve(StringObj *str, size_t length); // Grows capacity geometrically,may move str.
+uint64_t string_hash(StringObj *str);
+size_t string_length(RuntimeVal str);
+bool string_equals(StringVal a, StringVal b);
+
+void obj_incref(Obj *obj);
+void obj_decref(Obj *obj);
 RuntimeVal runtimeval_null();
 
 void dump_value(RuntimeVal val);
+void print_value(RuntimeVal val); // dump_value without the newline.
+void print_nested_value(RuntimeVal val); // print_value,but strings are quoted.For what's inside maps and records.
+size_t format_number(double n, char *buf, size_t size); // The way dump_value prints a non-integer number.
+void print_number(double n); // format_number to stdout,however long the result.
+#define FORMAT_INTEGER_MAX 20 // Characters in INT64_MIN,the longest int64_t.
+size_t format_integer(int64_t value, char *buf); // buf needs FORMAT_INTEGER_MAX + 1 bytes.Returns the length.
 
 RuntimeVal copy_value(RuntimeVal val);
 
 void free_value(RuntimeVal *val);
-#endif
\ No newline at end of file
+#endif
@@ -1,9 +1,11 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 #include "frontend/ast.h"
 #include "frontend/lexer.h"
 
-Expr *make_expr_numeric(int n)
+Expr *make_expr_numeric(int64_t n)
 {
     Expr *ret = malloc(sizeof(Expr));
     if (!ret)
@@ -13,10 +15,23 @@ Expr *make_expr_numeric(int n)
     }
 
     ret->data.n.x = n;
+    ret->data.n.digits = NULL;
     ret->kind = EXPR_NumericLiteral;
     return ret;
 }
 
+Expr *make_expr_numeric_digits(char *digits)
+{
+    Expr *ret = make_expr_numeric(0);
+    ret->data.n.digits = my_str_dup(digits);
+    if (!ret->data.n.digits)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during copying of integer literal.\n");
+        exit(EXIT_FAILURE);
+    }
+    return ret;
+}
+
 Expr *make_expr_string(char *s)
 {
     char *copied = my_str_dup(s);
@@ -51,6 +66,8 @@ Expr *make_expr_ident(char *c)
         exit(EXIT_FAILURE);
     }
     ret->data.i.symbol = copied;
+    ret->data.i.depth = 0;
+    ret->data.i.slot = VAR_UNRESOLVED;
     ret->kind = EXPR_Identifier;
     return ret;
 }
@@ -89,7 +106,7 @@ Expr *make_expr_binary(Expr *left, Expr *right, char *op)
     return ret;
 }
 
-Expr *make_expr_assignment(Expr *assigne, Expr *value)
+Expr *make_expr_assignment(Expr *assigne, Expr *value, char *op)
 {
     Expr *ret = malloc(sizeof(Expr));
     if (!ret)
@@ -99,10 +116,226 @@ Expr *make_expr_assignment(Expr *assigne, Expr *value)
     }
     ret->data.a.assigne = assigne;
     ret->data.a.value = value;
+    ret->data.a.op = NULL;
+    if (op)
+    {
+        ret->data.a.op = my_str_dup(op);
+        if (!ret->data.a.op)
+        {
+            fprintf(stderr, "Memory allocation error. Happened during copying of compound assignment operator.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
     ret->kind = EXPR_AssignmentExpr;
     return ret;
 }
 
+Expr *make_expr_array(Expr **elements, size_t len)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    if (!ret)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during allocation of Expr on the heap.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.arr.elements = elements;
+    ret->data.arr.len = len;
+    ret->kind = EXPR_ArrayLiteral;
+    return ret;
+}
+
+Expr *make_expr_index(Expr *target, Expr *index)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    if (!ret)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during allocation of Expr on the heap.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.idx.target = target;
+    ret->data.idx.index = index;
+    ret->kind = EXPR_IndexExpr;
+    return ret;
+}
+
+Expr *make_expr_call(char *callee, Expr **args, size_t argc)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    char *copied = my_str_dup(callee);
+    if (!ret || !copied)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during making of a CallExpr.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.call.callee = copied;
+    ret->data.call.args = args;
+    ret->data.call.argc = argc;
+    ret->data.call.builtin = NULL;
+    ret->kind = EXPR_CallExpr;
+    return ret;
+}
+
+Expr *make_expr_map(Expr **keys, Expr **values, size_t len)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    if (!ret)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during allocation of Expr on the heap.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.map.keys = keys;
+    ret->data.map.values = values;
+    ret->data.map.len = len;
+    ret->kind = EXPR_MapLiteral;
+    return ret;
+}
+
+Expr *make_expr_member(Expr *object, char *property)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    char *copied = my_str_dup(property);
+    if (!ret || !copied)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during making of a MemberExpr.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.mem.object = object;
+    ret->data.mem.property = copied;
+    memset(ret->data.mem.cache, 0, sizeof ret->data.mem.cache);
+    ret->kind = EXPR_MemberExpr;
+    return ret;
+}
+
+Expr *make_expr_record(char **names, Expr **values, size_t len)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    if (!ret)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during allocation of Expr on the heap.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.rec.names = names;
+    ret->data.rec.values = values;
+    ret->data.rec.len = len;
+    ret->data.rec.shape = NULL;
+    ret->kind = EXPR_RecordLiteral;
+    return ret;
+}
+
+Expr *make_expr_template(char **parts, Expr **holes, size_t nholes)
+{
+    Expr *ret = malloc(sizeof(Expr));
+    size_t *partlens = malloc(sizeof(size_t) * (nholes + 1));
+    if (!ret || !partlens)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during making of a TemplateLiteral.\n");
+        exit(EXIT_FAILURE);
+    }
+    ret->data.tpl.literal_length = 0;
+    for (size_t i = 0; i <= nholes; i++)
+    {
+        partlens[i] = strlen(parts[i]);
+        ret->data.tpl.literal_length += partlens[i];
+    }
+    ret->data.tpl.parts = parts;
+    ret->data.tpl.partlens = partlens;
+    ret->data.tpl.holes = holes;
+    ret->data.tpl.nholes = nholes;
+    ret->kind = EXPR_TemplateLiteral;
+    return ret;
+}
+
+static Expr **clone_exprs(Expr **exprs, size_t len)
+{
+    Expr **ret = malloc((len ? len : 1) * sizeof(Expr *));
+    if (!ret)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during cloning of an expression list.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < len; i++)
+        ret[i] = clone_expr(exprs[i]);
+    return ret;
+}
+
+Expr *clone_expr(Expr *expr)
+{
+    if (!expr)
+        return NULL;
+
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+        return expr->data.n.digits ? make_expr_numeric_digits(expr->data.n.digits) : make_expr_numeric(expr->data.n.x);
+    case EXPR_StringLiteral:
+        return make_expr_string(expr->data.s.s);
+    case EXPR_Identifier:
+    {
+        Expr *ret = make_expr_ident(expr->data.i.symbol);
+        ret->data.i.depth = expr->data.i.depth; // Still evaluated in the same scopes.
+        ret->data.i.slot = expr->data.i.slot;
+        return ret;
+    }
+    case EXPR_UnaryExpr:
+        return make_expr_unary(clone_expr(expr->data.ue.on), expr->data.ue.op);
+    case EXPR_BinaryExpr:
+        return make_expr_binary(clone_expr(expr->data.be.left), clone_expr(expr->data.be.right), expr->data.be.op);
+    case EXPR_AssignmentExpr:
+        return make_expr_assignment(clone_expr(expr->data.a.assigne), clone_expr(expr->data.a.value), expr->data.a.op);
+    case EXPR_ArrayLiteral:
+        return make_expr_array(clone_exprs(expr->data.arr.elements, expr->data.arr.len), expr->data.arr.len);
+    case EXPR_IndexExpr:
+        return make_expr_index(clone_expr(expr->data.idx.target), clone_expr(expr->data.idx.index));
+    case EXPR_CallExpr:
+        return make_expr_call(expr->data.call.callee, clone_exprs(expr->data.call.args, expr->data.call.argc), expr->data.call.argc);
+    case EXPR_MapLiteral:
+        return make_expr_map(clone_exprs(expr->data.map.keys, expr->data.map.len), clone_exprs(expr->data.map.values, expr->data.map.len), expr->data.map.len);
+    case EXPR_MemberExpr:
+        return make_expr_member(clone_expr(expr->data.mem.object), expr->data.mem.property);
+    case EXPR_RecordLiteral:
+    {
+        char **names = malloc(sizeof(char *) * (expr->data.rec.len ? expr->data.rec.len : 1));
+        if (!names)
+        {
+            fprintf(stderr, "Memory allocation error. Happened during cloning of a RecordLiteral.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+        {
+            names[i] = my_str_dup(expr->data.rec.names[i]);
+            if (!names[i])
+            {
+                fprintf(stderr, "Memory allocation error. Happened during cloning of a RecordLiteral.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        return make_expr_record(names, clone_exprs(expr->data.rec.values, expr->data.rec.len), expr->data.rec.len);
+    }
+    case EXPR_TemplateLiteral:
+    {
+        char **parts = malloc(sizeof(char *) * (expr->data.tpl.nholes + 1));
+        if (!parts)
+        {
+            fprintf(stderr, "Memory allocation error. Happened during cloning of a TemplateLiteral.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i <= expr->data.tpl.nholes; i++)
+        {
+            parts[i] = my_str_dup(expr->data.tpl.parts[i]);
+            if (!parts[i])
+            {
+                fprintf(stderr, "Memory allocation error. Happened during cloning of a TemplateLiteral.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        return make_expr_template(parts, clone_exprs(expr->data.tpl.holes, expr->data.tpl.nholes), expr->data.tpl.nholes);
+    }
+    default:
+        fprintf(stderr, "Exhaustive handling of expression types in clone_expr.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
 Stmt *make_stmt_expr_stmt(Expr *expr)
 {
     Stmt *ret = malloc(sizeof(Stmt));
@@ -131,6 +364,7 @@ Stmt *make_stmt_var_decl_stmt(char *ident,Expr *value, int isConst){
     }
     ret->data.vds.value = value;
     ret->data.vds.isConst = isConst;
+    ret->data.vds.slot = VAR_UNRESOLVED;
     ret->kind = NODE_VariableDeclarationStmt;
     return ret;
 }
@@ -171,6 +405,7 @@ void free_expr(Expr *expr)
     switch (expr->kind)
     {
     case EXPR_NumericLiteral:
+        free(expr->data.n.digits);
         break;
     case EXPR_Identifier:
         free(expr->data.i.symbol);
@@ -179,7 +414,7 @@ void free_expr(Expr *expr)
         free(expr->data.s.s);
         break;
     case EXPR_UnaryExpr:
-        free(expr->data.ue.on);
+        free_expr(expr->data.ue.on);
         break;
     case EXPR_BinaryExpr:
         free_expr(expr->data.be.left);
@@ -189,6 +424,53 @@ void free_expr(Expr *expr)
     case EXPR_AssignmentExpr:
         free_expr(expr->data.a.assigne);
         free_expr(expr->data.a.value);
+        free(expr->data.a.op);
+        break;
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+            free_expr(expr->data.arr.elements[i]);
+        free(expr->data.arr.elements);
+        break;
+    case EXPR_IndexExpr:
+        free_expr(expr->data.idx.target);
+        free_expr(expr->data.idx.index);
+        break;
+    case EXPR_CallExpr:
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+            free_expr(expr->data.call.args[i]);
+        free(expr->data.call.args);
+        free(expr->data.call.callee);
+        break;
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            free_expr(expr->data.map.keys[i]);
+            free_expr(expr->data.map.values[i]);
+        }
+        free(expr->data.map.keys);
+        free(expr->data.map.values);
+        break;
+    case EXPR_MemberExpr:
+        free_expr(expr->data.mem.object);
+        free(expr->data.mem.property);
+        break;
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+        {
+            free(expr->data.rec.names[i]);
+            free_expr(expr->data.rec.values[i]);
+        }
+        free(expr->data.rec.names);
+        free(expr->data.rec.values);
+        break;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i <= expr->data.tpl.nholes; i++)
+            free(expr->data.tpl.parts[i]);
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+            free_expr(expr->data.tpl.holes[i]);
+        free(expr->data.tpl.parts);
+        free(expr->data.tpl.partlens);
+        free(expr->data.tpl.holes);
         break;
     default:
         fprintf(stderr, "Exhaustive handling of expression types in free_expr.\n");
@@ -247,6 +529,20 @@ static const char *expr_kind_str(ExprType kind)
         return "BinaryExpr";
     case EXPR_AssignmentExpr:
         return "AssignmentExpr";
+    case EXPR_ArrayLiteral:
+        return "ArrayLiteral";
+    case EXPR_IndexExpr:
+        return "IndexExpr";
+    case EXPR_CallExpr:
+        return "CallExpr";
+    case EXPR_MapLiteral:
+        return "MapLiteral";
+    case EXPR_MemberExpr:
+        return "MemberExpr";
+    case EXPR_RecordLiteral:
+        return "RecordLiteral";
+    case EXPR_TemplateLiteral:
+        return "TemplateLiteral";
     default:
         fprintf(stderr, "Unknown ExprType in expr_kind_str\n");
         exit(EXIT_FAILURE);
@@ -289,7 +585,10 @@ void dump_expr(Expr *expr, int depth)
     case EXPR_NumericLiteral:
         printf(",\n");
         indent(depth + 1);
-        printf("\"value\": %d\n", expr->data.n.x);
+        if (expr->data.n.digits)
+            printf("\"value\": %s\n", expr->data.n.digits);
+        else
+            printf("\"value\": %" PRId64 "\n", expr->data.n.x);
         break;
 
     case EXPR_Identifier:
@@ -335,6 +634,12 @@ void dump_expr(Expr *expr, int depth)
     case EXPR_AssignmentExpr:
         printf(",\n");
 
+        if (expr->data.a.op)
+        {
+            indent(depth + 1);
+            printf("\"op\": \"%s=\",\n", expr->data.a.op);
+        }
+
         indent(depth + 1);
         printf("\"assigne\": ");
         dump_expr(expr->data.a.assigne, depth + 1);
@@ -345,6 +650,114 @@ void dump_expr(Expr *expr, int depth)
         dump_expr(expr->data.a.value, depth + 1);
         printf("\n");
         break;
+    case EXPR_ArrayLiteral:
+        printf(",\n");
+        indent(depth + 1);
+        printf("\"elements\": [\n");
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+        {
+            dump_expr(expr->data.arr.elements[i], depth + 2);
+            printf(i + 1 < expr->data.arr.len ? ",\n" : "\n");
+        }
+        indent(depth + 1);
+        printf("]\n");
+        break;
+    case EXPR_IndexExpr:
+        printf(",\n");
+
+        indent(depth + 1);
+        printf("\"target\": ");
+        dump_expr(expr->data.idx.target, depth + 1);
+        printf(",\n");
+
+        indent(depth + 1);
+        printf("\"index\": ");
+        dump_expr(expr->data.idx.index, depth + 1);
+        printf("\n");
+        break;
+    case EXPR_CallExpr:
+        printf(",\n");
+        indent(depth + 1);
+        printf("\"callee\": \"%s\",\n", expr->data.call.callee);
+        indent(depth + 1);
+        printf("\"args\": [\n");
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+        {
+            dump_expr(expr->data.call.args[i], depth + 2);
+            printf(i + 1 < expr->data.call.argc ? ",\n" : "\n");
+        }
+        indent(depth + 1);
+        printf("]\n");
+        break;
+    case EXPR_MapLiteral:
+        printf(",\n");
+        indent(depth + 1);
+        printf("\"entries\": [\n");
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            indent(depth + 2);
+            printf("{\n");
+            indent(depth + 3);
+            printf("\"key\": ");
+            dump_expr(expr->data.map.keys[i], depth + 3);
+            printf(",\n");
+            indent(depth + 3);
+            printf("\"value\": ");
+            dump_expr(expr->data.map.values[i], depth + 3);
+            printf("\n");
+            indent(depth + 2);
+            printf(i + 1 < expr->data.map.len ? "},\n" : "}\n");
+        }
+        indent(depth + 1);
+        printf("]\n");
+        break;
+    case EXPR_MemberExpr:
+        printf(",\n");
+
+        indent(depth + 1);
+        printf("\"object\": ");
+        dump_expr(expr->data.mem.object, depth + 1);
+        printf(",\n");
+
+        indent(depth + 1);
+        printf("\"property\": \"%s\"\n", expr->data.mem.property);
+        break;
+    case EXPR_RecordLiteral:
+        printf(",\n");
+        indent(depth + 1);
+        printf("\"fields\": {\n");
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+        {
+            indent(depth + 2);
+            printf("\"%s\": ", expr->data.rec.names[i]);
+            dump_expr(expr->data.rec.values[i], depth + 2);
+            printf(i + 1 < expr->data.rec.len ? ",\n" : "\n");
+        }
+        indent(depth + 1);
+        printf("}\n");
+        break;
+    case EXPR_TemplateLiteral:
+        printf(",\n");
+        indent(depth + 1);
+        printf("\"parts\": [\n");
+        for (size_t i = 0; i <= expr->data.tpl.nholes; i++)
+        {
+            indent(depth + 2);
+            printf("\"%s\"%s\n", expr->data.tpl.parts[i], i < expr->data.tpl.nholes ? "," : "");
+        }
+        indent(depth + 1);
+        printf("],\n");
+        indent(depth + 1);
+        printf("\"holes\": [\n");
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+        {
+            indent(depth + 2);
+            dump_expr(expr->data.tpl.holes[i], depth + 2);
+            printf(i + 1 < expr->data.tpl.nholes ? ",\n" : "\n");
+        }
+        indent(depth + 1);
+        printf("]\n");
+        break;
     default:
         fprintf(stderr, "Exhaustive handling of ExprType in dump_expr\n");
         exit(EXIT_FAILURE);
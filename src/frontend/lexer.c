@@ -56,6 +56,47 @@ void tk_arr_append(TokenArray *arr, Token tok)
     arr->tokens[arr->len++] = tok;
 }
 
+const char *string_end(const char *src, int *holes)
+{
+    while (*src && *src != '"')
+    {
+        if (src[0] == '$' && src[1] == '{')
+        {
+            *holes = 1;
+            src = template_hole_end(src + 2);
+            if (!*src)
+                return src;
+        }
+        src++;
+    }
+    return src;
+}
+
+const char *template_hole_end(const char *src)
+{
+    int depth = 1;
+    while (*src)
+    {
+        if (*src == '"')
+        {
+            int holes = 0;
+            src = string_end(src + 1, &holes); // A string inside the hole can have its own holes.
+            if (!*src)
+                return src;
+        }
+        else if (*src == '{')
+        {
+            depth++;
+        }
+        else if (*src == '}' && !--depth)
+        {
+            return src;
+        }
+        src++;
+    }
+    return src;
+}
+
 int is_unop(char c)
 {
     return c == '!' || c == '~';
@@ -63,7 +104,7 @@ int is_unop(char c)
 
 int is_binop(char c)
 {
-    return c == '+' || c == '-' || c == '*' || c == '/';
+    return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '&' || c == '|' || c == '^';
 }
 
 char *binopstr(char c)
@@ -78,6 +119,14 @@ char *binopstr(char c)
         return "*";
     case '/':
         return "/";
+    case '%':
+        return "%";
+    case '&':
+        return "&";
+    case '|':
+        return "|";
+    case '^':
+        return "^";
     default:
         fprintf(stderr, "Exhaustive handling of binary operators in binopstr\n");
         exit(EXIT_FAILURE);
@@ -194,40 +243,27 @@ Token *tokenize(const char *src)
         }
         else if (*src == '"')
         {
-            size_t len = 0;
-            size_t cap = 1024;
-            char *buf = malloc(cap + 1);
-            if (!buf)
-            {
-                fprintf(stderr, "Memory allocation error. Happened during number building\n");
-                exit(EXIT_FAILURE);
-            }
             src++;
-            while (*src && *src != '"')
+            int holes = 0;
+            const char *end = string_end(src, &holes);
+            if (*end != '"') // We reached end of src,but didnt get '"'
             {
-                if (len == cap)
-                {
-                    cap += 1024;
-                    char *tmp = realloc(buf, cap);
-                    if (!tmp)
-                    {
-                        free(buf);
-                        fprintf(stderr, "Memory reallocation error. Happened during number building.\n");
-                        exit(EXIT_FAILURE);
-                    }
-                    buf = tmp;
-                }
-                buf[len++] = *src++;
+                fprintf(stderr, "String literal not ended.\n");
+                exit(EXIT_FAILURE);
             }
-            if (*src != '"') // We reached end of src,but didnt get '"'
+            size_t len = end - src;
+            char *buf = malloc(len + 1);
+            if (!buf)
             {
-                fprintf(stderr, "String literal not ended.\n");
+                fprintf(stderr, "Memory allocation error. Happened during string building\n");
                 exit(EXIT_FAILURE);
             }
-            buf[len++] = '\0';
-            tk_arr_append(&ret, token(buf, TOKENTYPE_String));
+            memcpy(buf, src, len);
+            buf[len] = '\0';
+            // Holes are kept as source,the parser splits the template and parses each one.
+            tk_arr_append(&ret, token(buf, holes ? TOKENTYPE_Template : TOKENTYPE_String));
             free(buf);
-            src++;
+            src = end + 1;
         }
         else if (*src == '(')
         {
@@ -239,8 +275,56 @@ Token *tokenize(const char *src)
             tk_arr_append(&ret, token(")", TOKENTYPE_CloseParen));
             src++;
         }
+        else if (*src == '[')
+        {
+            tk_arr_append(&ret, token("[", TOKENTYPE_OpenBracket));
+            src++;
+        }
+        else if (*src == ']')
+        {
+            tk_arr_append(&ret, token("]", TOKENTYPE_CloseBracket));
+            src++;
+        }
+        else if (*src == '{')
+        {
+            tk_arr_append(&ret, token("{", TOKENTYPE_OpenBrace));
+            src++;
+        }
+        else if (*src == '}')
+        {
+            tk_arr_append(&ret, token("}", TOKENTYPE_CloseBrace));
+            src++;
+        }
+        else if (*src == ',')
+        {
+            tk_arr_append(&ret, token(",", TOKENTYPE_Comma));
+            src++;
+        }
+        else if (*src == ':')
+        {
+            tk_arr_append(&ret, token(":", TOKENTYPE_Colon));
+            src++;
+        }
+        else if (*src == '.')
+        {
+            tk_arr_append(&ret, token(".", TOKENTYPE_Dot));
+            src++;
+        }
         else if (*src == '>')
         {
+            if (src[1] == '>' && src[2] == '=')
+            {
+                tk_arr_append(&ret, token(">>=", TOKENTYPE_CompoundAssignment));
+                src += 3;
+                continue;
+            }
+            if (src[1] == '>')
+            {
+                tk_arr_append(&ret, token(">>", TOKENTYPE_BinaryOperator));
+                src++;
+                src++;
+                continue;
+            }
             if (src[1] == '=')
             {
                 tk_arr_append(&ret, token(">=", TOKENTYPE_BinaryOperator));
@@ -254,6 +338,19 @@ Token *tokenize(const char *src)
         }
         else if (*src == '<')
         {
+            if (src[1] == '<' && src[2] == '=')
+            {
+                tk_arr_append(&ret, token("<<=", TOKENTYPE_CompoundAssignment));
+                src += 3;
+                continue;
+            }
+            if (src[1] == '<')
+            {
+                tk_arr_append(&ret, token("<<", TOKENTYPE_BinaryOperator));
+                src++;
+                src++;
+                continue;
+            }
             if (src[1] == '=')
             {
                 tk_arr_append(&ret, token("<=", TOKENTYPE_BinaryOperator));
@@ -326,6 +423,13 @@ Token *tokenize(const char *src)
             src++;
             src++;
         }
+        else if (is_binop(*src) && src[1] == '=')
+        {
+            char op[3] = {*src, '=', '\0'};
+            tk_arr_append(&ret, token(op, TOKENTYPE_CompoundAssignment));
+            src++;
+            src++;
+        }
         else if (is_binop(*src))
         {
             tk_arr_append(&ret, token(binopstr(*src), TOKENTYPE_BinaryOperator));
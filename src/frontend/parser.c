@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "frontend/parser.h"
 
 void parser_init(Parser *p, Token *tokens)
@@ -102,20 +103,100 @@ Expr *parse_expr(Parser *p)
 
 Expr *parse_assignment_expr(Parser *p)
 {
-    Expr *assigne = parse_comparision_expr(p);
+    Expr *assigne = parse_bitwise_or_expr(p);
     if (at(p).kind == TOKENTYPE_Equals)
     {
         eat(p);
         Expr *value = parse_expr(p);
-        return make_expr_assignment(assigne,value);
+        return make_expr_assignment(assigne,value,NULL);
+    }
+    if (at(p).kind == TOKENTYPE_CompoundAssignment)
+    {
+        char *tok = eat(p).value;
+        char op[4] = {0};
+        memcpy(op, tok, strlen(tok) - 1); // Drop the '='.
+        Expr *value = parse_expr(p);
+        return make_expr_assignment(assigne,value,op);
     }
     return assigne;
 }
 
+Expr *parse_bitwise_or_expr(Parser *p)
+{
+    Expr *left = parse_bitwise_xor_expr(p);
+    while (at(p).value && !strcmp(at(p).value, "|"))
+    {
+        char *op = my_str_dup(eat(p).value);
+        if (!op)
+        {
+            fprintf(stderr,"Memory allocation error when copying operation.");
+            exit(EXIT_FAILURE);
+        }
+        Expr *right = parse_bitwise_xor_expr(p);
+        left = make_expr_binary(left,right,op);
+        free(op);
+    }
+    return left;
+}
+
+Expr *parse_bitwise_xor_expr(Parser *p)
+{
+    Expr *left = parse_bitwise_and_expr(p);
+    while (at(p).value && !strcmp(at(p).value, "^"))
+    {
+        char *op = my_str_dup(eat(p).value);
+        if (!op)
+        {
+            fprintf(stderr,"Memory allocation error when copying operation.");
+            exit(EXIT_FAILURE);
+        }
+        Expr *right = parse_bitwise_and_expr(p);
+        left = make_expr_binary(left,right,op);
+        free(op);
+    }
+    return left;
+}
+
+Expr *parse_bitwise_and_expr(Parser *p)
+{
+    Expr *left = parse_comparision_expr(p);
+    while (at(p).value && !strcmp(at(p).value, "&"))
+    {
+        char *op = my_str_dup(eat(p).value);
+        if (!op)
+        {
+            fprintf(stderr,"Memory allocation error when copying operation.");
+            exit(EXIT_FAILURE);
+        }
+        Expr *right = parse_comparision_expr(p);
+        left = make_expr_binary(left,right,op);
+        free(op);
+    }
+    return left;
+}
+
 Expr *parse_comparision_expr(Parser *p)
 {
-    Expr *left = parse_additive_expr(p);
+    Expr *left = parse_shift_expr(p);
     while (at(p).value && (!strcmp(at(p).value, "==") || !strcmp(at(p).value, ">=") || !strcmp(at(p).value, "<=") || !strcmp(at(p).value, ">") || !strcmp(at(p).value, "<")))
+    {
+        char *op = my_str_dup(eat(p).value);
+        if (!op)
+        {
+            fprintf(stderr,"Memory allocation error when copying operation.");
+            exit(EXIT_FAILURE);
+        }
+        Expr *right = parse_shift_expr(p);
+        left = make_expr_binary(left,right,op);
+        free(op);
+    }
+    return left;
+}
+
+Expr *parse_shift_expr(Parser *p)
+{
+    Expr *left = parse_additive_expr(p);
+    while (at(p).value && (!strcmp(at(p).value, "<<") || !strcmp(at(p).value, ">>")))
     {
         char *op = my_str_dup(eat(p).value);
         if (!op)
@@ -151,7 +232,7 @@ Expr *parse_additive_expr(Parser *p)
 Expr *parse_multiplicative_expr(Parser *p)
 {
     Expr *left = parse_unary_expr(p);
-    while (at(p).value && (!strcmp(at(p).value,"*") || !strcmp(at(p).value,"/")))
+    while (at(p).value && (!strcmp(at(p).value,"*") || !strcmp(at(p).value,"/") || !strcmp(at(p).value,"%")))
     {
         char *op = my_str_dup(eat(p).value);
         if (!op)
@@ -169,13 +250,199 @@ Expr *parse_multiplicative_expr(Parser *p)
 Expr *parse_unary_expr(Parser *p)
 {
     // when something like -- is added,change the check.
-    if (at(p).kind == TOKENTYPE_UnaryOperator || *at(p).value == '-')
+    if (at(p).kind == TOKENTYPE_UnaryOperator || (at(p).kind == TOKENTYPE_BinaryOperator && *at(p).value == '-'))
     {
         char op = *eat(p).value;
-        Expr *on = parse_primary_expr(p);
+        Expr *on = parse_postfix_expr(p);
         return make_expr_unary(on, op);
     }
-    return parse_primary_expr(p);
+    return parse_postfix_expr(p);
+}
+
+// Comma separated expressions up to the closing token,which is eaten too.
+static Expr **parse_expr_list(Parser *p, TokenType close, const char *err, size_t *len)
+{
+    size_t cap = 4;
+    Expr **list = malloc(cap * sizeof(Expr *));
+    if (!list)
+    {
+        fprintf(stderr,"Memory allocation error when allocating expression list.\n");
+        exit(EXIT_FAILURE);
+    }
+    *len = 0;
+    while (at(p).kind != close)
+    {
+        if (*len == cap)
+        {
+            cap *= 2;
+            Expr **grown = realloc(list, cap * sizeof(Expr *));
+            if (!grown)
+            {
+                fprintf(stderr,"Memory allocation error when growing expression list.\n");
+                exit(EXIT_FAILURE);
+            }
+            list = grown;
+        }
+        list[(*len)++] = parse_expr(p);
+        if (at(p).kind != TOKENTYPE_Comma)
+            break;
+        eat(p);
+    }
+    expecterr(p,close,err);
+    return list;
+}
+
+// {x = 1, y = 2},after the {.Field names are fixed,so no expression is allowed in place of one.
+static Expr *parse_record_literal(Parser *p)
+{
+    size_t len = 0, cap = 4;
+    char **names = malloc(cap * sizeof(char *));
+    Expr **values = malloc(cap * sizeof(Expr *));
+    if (!names || !values)
+    {
+        fprintf(stderr,"Memory allocation error when allocating record literal.\n");
+        exit(EXIT_FAILURE);
+    }
+    while (at(p).kind != TOKENTYPE_CloseBrace)
+    {
+        if (len == cap)
+        {
+            cap *= 2;
+            names = realloc(names, cap * sizeof(char *));
+            values = realloc(values, cap * sizeof(Expr *));
+            if (!names || !values)
+            {
+                fprintf(stderr,"Memory allocation error when growing record literal.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        char *name = expecterr(p,TOKENTYPE_Identifier,"Expected a field name in record literal").value;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (!strcmp(names[i], name))
+            {
+                fprintf(stderr,"Field %s appears twice in record literal.\n", name);
+                exit(EXIT_FAILURE);
+            }
+        }
+        names[len] = my_str_dup(name);
+        if (!names[len])
+        {
+            fprintf(stderr,"Memory allocation error when copying field name.\n");
+            exit(EXIT_FAILURE);
+        }
+        expecterr(p,TOKENTYPE_Equals,"Expected = after a field name");
+        values[len++] = parse_expr(p);
+        if (at(p).kind != TOKENTYPE_Comma)
+            break;
+        eat(p);
+    }
+    expecterr(p,TOKENTYPE_CloseBrace,"Expected } to an {");
+    return make_expr_record(names,values,len);
+}
+
+static char *copy_span(const char *start, const char *end)
+{
+    char *ret = malloc(end - start + 1);
+    if (!ret)
+    {
+        fprintf(stderr,"Memory allocation error when splitting string template.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(ret, start, end - start);
+    ret[end - start] = '\0';
+    return ret;
+}
+
+// Splits "a${x}b" into the literal parts and the holes,and parses every hole as an expression of its own.
+static Expr *parse_template(const char *src)
+{
+    size_t nholes = 0, cap = 4;
+    char **parts = malloc(sizeof(char *) * (cap + 1));
+    Expr **holes = malloc(sizeof(Expr *) * cap);
+    if (!parts || !holes)
+    {
+        fprintf(stderr,"Memory allocation error when allocating string template.\n");
+        exit(EXIT_FAILURE);
+    }
+    const char *start = src;
+    for (;;)
+    {
+        const char *open = strstr(start, "${");
+        if (!open)
+            break;
+        if (nholes == cap)
+        {
+            cap *= 2;
+            parts = realloc(parts, sizeof(char *) * (cap + 1));
+            holes = realloc(holes, sizeof(Expr *) * cap);
+            if (!parts || !holes)
+            {
+                fprintf(stderr,"Memory allocation error when growing string template.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        const char *close = template_hole_end(open + 2); // The lexer already made sure there is one.
+        parts[nholes] = copy_span(start, open);
+
+        char *source = copy_span(open + 2, close);
+        Token *tokens = tokenize(source);
+        if (tokens[0].kind == TOKENTYPE_Eof)
+        {
+            fprintf(stderr,"Expected an expression in template hole ${%s}\n", source);
+            exit(EXIT_FAILURE);
+        }
+        Parser hole;
+        parser_init(&hole,tokens);
+        holes[nholes++] = parse_expr(&hole);
+        if (at(&hole).kind != TOKENTYPE_Eof)
+        {
+            fprintf(stderr,"Expected } after the expression in ${%s}\n", source);
+            exit(EXIT_FAILURE);
+        }
+        free_tokens(tokens);
+        free(source);
+        start = close + 1;
+    }
+    parts[nholes] = copy_span(start, start + strlen(start));
+    return make_expr_template(parts,holes,nholes);
+}
+
+Expr *parse_postfix_expr(Parser *p)
+{
+    Expr *ret;
+    if (at(p).kind == TOKENTYPE_Identifier && p->tokens[p->i + 1].kind == TOKENTYPE_OpenParen)
+    {
+        char *callee = eat(p).value;
+        eat(p);
+        size_t argc;
+        Expr **args = parse_expr_list(p,TOKENTYPE_CloseParen,"Expected ) to end the arguments of a call",&argc);
+        ret = make_expr_call(callee,args,argc); // Indexed or accessed like any other value,f(x)[i] and f(x).y.
+    }
+    else
+    {
+        ret = parse_primary_expr(p);
+    }
+    for (;;)
+    {
+        if (at(p).kind == TOKENTYPE_OpenBracket)
+        {
+            eat(p);
+            Expr *index = parse_expr(p);
+            expecterr(p,TOKENTYPE_CloseBracket,"Expected ] to an [");
+            ret = make_expr_index(ret,index);
+        }
+        else if (at(p).kind == TOKENTYPE_Dot)
+        {
+            eat(p);
+            char *property = expecterr(p,TOKENTYPE_Identifier,"Expected a field name after .").value;
+            ret = make_expr_member(ret,property);
+        }
+        else
+        {
+            return ret;
+        }
+    }
 }
 
 Expr *parse_primary_expr(Parser *p)
@@ -185,14 +452,66 @@ Expr *parse_primary_expr(Parser *p)
     case TOKENTYPE_Identifier:
         return make_expr_ident(eat(p).value);
     case TOKENTYPE_Number:
-        return make_expr_numeric(atoi(eat(p).value));
+    {
+        char *digits = eat(p).value;
+        errno = 0;
+        long long n = strtoll(digits, NULL, 10);
+        if (errno == ERANGE)
+            return make_expr_numeric_digits(digits); // Becomes a bigint.
+        return make_expr_numeric(n);
+    }
     case TOKENTYPE_String:
         return make_expr_string(eat(p).value);
+    case TOKENTYPE_Template:
+        return parse_template(eat(p).value);
     case TOKENTYPE_OpenParen:
         eat(p);
         Expr *ret = parse_expr(p);
         expecterr(p,TOKENTYPE_CloseParen,"Expected ) to an (");
         return ret;
+    case TOKENTYPE_OpenBrace:
+    {
+        eat(p);
+        if (at(p).kind == TOKENTYPE_Identifier && p->tokens[p->i + 1].kind == TOKENTYPE_Equals)
+            return parse_record_literal(p);
+        size_t len = 0, cap = 4;
+        Expr **keys = malloc(cap * sizeof(Expr *));
+        Expr **values = malloc(cap * sizeof(Expr *));
+        if (!keys || !values)
+        {
+            fprintf(stderr,"Memory allocation error when allocating map literal.\n");
+            exit(EXIT_FAILURE);
+        }
+        while (at(p).kind != TOKENTYPE_CloseBrace)
+        {
+            if (len == cap)
+            {
+                cap *= 2;
+                keys = realloc(keys, cap * sizeof(Expr *));
+                values = realloc(values, cap * sizeof(Expr *));
+                if (!keys || !values)
+                {
+                    fprintf(stderr,"Memory allocation error when growing map literal.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            keys[len] = parse_expr(p);
+            expecterr(p,TOKENTYPE_Colon,"Expected : between a key and its value");
+            values[len++] = parse_expr(p);
+            if (at(p).kind != TOKENTYPE_Comma)
+                break;
+            eat(p);
+        }
+        expecterr(p,TOKENTYPE_CloseBrace,"Expected } to an {");
+        return make_expr_map(keys,values,len);
+    }
+    case TOKENTYPE_OpenBracket:
+    {
+        eat(p);
+        size_t len;
+        Expr **elements = parse_expr_list(p,TOKENTYPE_CloseBracket,"Expected ] to an [",&len);
+        return make_expr_array(elements,len);
+    }
     case TOKENTYPE_UnaryOperator:
         return parse_unary_expr(p);
     case TOKENTYPE_BinaryOperator:
@@ -9,13 +9,138 @@
 #include "runtime/values.h"
 #include "runtime/scope.h"
 #include "runtime/interpreter.h"
+#include "runtime/reactive.h"
+#include "runtime/gc.h"
+#include "runtime/snapshot.h"
 
-int main()
+// Evaluates every line of path in scope,like lines typed into the REPL but without printing them.
+static void run_prelude(const char *path, Scope *scope, Parser *p)
 {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Could not open prelude %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t len = 0, cap = 1024;
+    char *src = malloc(cap + 1);
+    size_t n;
+    while (src && (n = fread(src + len, 1, cap - len, f)) > 0)
+    {
+        len += n;
+        if (len == cap)
+        {
+            cap *= 2;
+            src = realloc(src, cap + 1);
+        }
+    }
+    fclose(f);
+    if (!src)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while reading prelude %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    src[len] = '\0';
+    for (char *line = src, *end; *line; line = end)
+    {
+        end = strchr(line, '\n');
+        end = end ? end : line + strlen(line);
+        int more = *end != '\0';
+        *end = '\0';
+        end += more;
+        if (!*line)
+            continue;
+        Program program = parse_src(line, p);
+        RuntimeVal evaled = eval_program(program, scope);
+        free_program(&program);
+        free_value(&evaled);
+    }
+    free(src);
+}
+
+int main(int argc, char **argv)
+{
+    const char *prelude = NULL;
+    const char *snapshot_in = NULL;
+    const char *snapshot_out = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--reactive"))
+        {
+            reactive_enabled = 1;
+        }
+        else if (!strcmp(argv[i], "--lazy"))
+        {
+            lazy_enabled = 1;
+        }
+        else if (!strcmp(argv[i], "--gc-budget") && i + 1 < argc)
+        {
+            char *end;
+            long long budget = strtoll(argv[++i], &end, 10);
+            if (*end || end == argv[i] || budget < 0)
+            {
+                fprintf(stderr, "--gc-budget takes a number of objects, 0 for no limit.\n");
+                exit(EXIT_FAILURE);
+            }
+            gc_set_budget((size_t)budget);
+        }
+        else if (!strcmp(argv[i], "--prelude") && i + 1 < argc)
+        {
+            prelude = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--snapshot-in") && i + 1 < argc)
+        {
+            snapshot_in = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--snapshot-out") && i + 1 < argc)
+        {
+            snapshot_out = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((prelude || snapshot_in || snapshot_out) && (reactive_enabled || lazy_enabled))
+    {
+        fprintf(stderr, "--prelude and snapshots can't be combined with --reactive or --lazy.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (snapshot_in && snapshot_out)
+    {
+        fprintf(stderr, "--snapshot-in can't be combined with --snapshot-out.\n");
+        exit(EXIT_FAILURE);
+    }
+
     int c;
     Parser p;
-    Scope s;
-    init_global_scope(&s);
+    // Started from a snapshot,the global scope is a fork of the one read from it.
+    Scope *frozen = snapshot_in ? snapshot_read(snapshot_in) : NULL;
+    Scope global;
+    if (frozen)
+        global = fork_scope(frozen);
+    else
+        init_global_scope(&global);
+    if (prelude)
+        run_prelude(prelude, &global, &p);
+    if (snapshot_out)
+    {
+        snapshot_write(&global, snapshot_out);
+        free_scope(&global);
+        gc_drain();
+        return 0;
+    }
+    // With a prelude,the REPL runs in a fork of the global scope it populated.
+    Scope s = global;
+    if (prelude)
+    {
+        Scope *below = frozen;
+        frozen = freeze_scope(&global);
+        release_scope(below); // The frozen prelude holds it now.
+        s = fork_scope(frozen);
+    }
     char *buf = NULL;
     size_t len;
     size_t cap;
@@ -54,6 +179,9 @@ int main()
             if (!strcmp(buf,"exit"))
             {
                 free_scope(&s);
+                if (frozen)
+                    release_scope(frozen);
+                gc_drain();
                 exit(0); //We cannot just "break" because it would print out a '\n'(since EOF was triggered.)
             }
 
@@ -69,5 +197,8 @@ int main()
     }
     printf("\n");
     free_scope(&s);
+    if (frozen)
+        release_scope(frozen);
+    gc_drain();
     return 0;
 }
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "runtime/values.h"
+#include "runtime/array.h"
+#include "runtime/slab.h"
+
+// One vector type per target,the kernels below are written against these macros only.
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256d vec;
+#define VEC_WIDTH 4
+#define vec_load(p) _mm256_load_pd(p)
+#define vec_store(p, v) _mm256_store_pd(p, v)
+#define vec_set1(x) _mm256_set1_pd(x)
+#define vec_add(a, b) _mm256_add_pd(a, b)
+#define vec_sub(a, b) _mm256_sub_pd(a, b)
+#define vec_mul(a, b) _mm256_mul_pd(a, b)
+#define vec_div(a, b) _mm256_div_pd(a, b)
+#define vec_min(a, b) _mm256_min_pd(a, b)
+#define vec_max(a, b) _mm256_max_pd(a, b)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128d vec;
+#define VEC_WIDTH 2
+#define vec_load(p) _mm_load_pd(p)
+#define vec_store(p, v) _mm_store_pd(p, v)
+#define vec_set1(x) _mm_set1_pd(x)
+#define vec_add(a, b) _mm_add_pd(a, b)
+#define vec_sub(a, b) _mm_sub_pd(a, b)
+#define vec_mul(a, b) _mm_mul_pd(a, b)
+#define vec_div(a, b) _mm_div_pd(a, b)
+#define vec_min(a, b) _mm_min_pd(a, b)
+#define vec_max(a, b) _mm_max_pd(a, b)
+#else
+typedef double vec;
+#define VEC_WIDTH 1
+#define vec_load(p) (*(p))
+#define vec_store(p, v) (*(p) = (v))
+#define vec_set1(x) (x)
+#define vec_add(a, b) ((a) + (b))
+#define vec_sub(a, b) ((a) - (b))
+#define vec_mul(a, b) ((a) * (b))
+#define vec_div(a, b) ((a) / (b))
+#define vec_min(a, b) ((a) < (b) ? (a) : (b))
+#define vec_max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define REDUCE_LANES 4 // Independent accumulators,so consecutive adds don't wait on each other.
+
+ArrayObj *array_alloc(size_t length)
+{
+    // aligned_alloc wants a multiple of the alignment.
+    size_t bytes = ((length ? length : 1) * sizeof(double) + ARRAY_ALIGN - 1) / ARRAY_ALIGN * ARRAY_ALIGN;
+    ArrayObj *arr = slab_alloc(sizeof(ArrayObj));
+    double *data = length <= (SIZE_MAX - ARRAY_ALIGN) / sizeof(double) ? aligned_alloc(ARRAY_ALIGN, bytes) : NULL;
+    if (!arr || !data)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating array of length %zu.\n", length);
+        exit(EXIT_FAILURE);
+    }
+    arr->obj.refcount = 1;
+    arr->obj.kind = OBJ_Array;
+    arr->length = length;
+    arr->data = data;
+    return arr;
+}
+
+RuntimeVal runtimeval_array(ArrayObj *arr)
+{
+    return runtimeval_obj(&arr->obj);
+}
+
+#define DEFINE_KERNELS(name, vop, sop)                                               \
+    static void name##_vv(double *out, const double *a, const double *b, size_t n)   \
+    {                                                                                \
+        size_t i = 0;                                                                \
+        for (; i + VEC_WIDTH <= n; i += VEC_WIDTH)                                   \
+            vec_store(out + i, vop(vec_load(a + i), vec_load(b + i)));               \
+        for (; i < n; i++)                                                           \
+            out[i] = sop(a[i], b[i]);                                                \
+    }                                                                                \
+    static void name##_vs(double *out, const double *a, double s, size_t n)          \
+    {                                                                                \
+        vec sv = vec_set1(s);                                                        \
+        size_t i = 0;                                                                \
+        for (; i + VEC_WIDTH <= n; i += VEC_WIDTH)                                   \
+            vec_store(out + i, vop(vec_load(a + i), sv));                            \
+        for (; i < n; i++)                                                           \
+            out[i] = sop(a[i], s);                                                   \
+    }                                                                                \
+    static void name##_sv(double *out, double s, const double *b, size_t n)          \
+    {                                                                                \
+        vec sv = vec_set1(s);                                                        \
+        size_t i = 0;                                                                \
+        for (; i + VEC_WIDTH <= n; i += VEC_WIDTH)                                   \
+            vec_store(out + i, vop(sv, vec_load(b + i)));                            \
+        for (; i < n; i++)                                                           \
+            out[i] = sop(s, b[i]);                                                   \
+    }
+
+#define scalar_add(a, b) ((a) + (b))
+#define scalar_sub(a, b) ((a) - (b))
+#define scalar_mul(a, b) ((a) * (b))
+#define scalar_div(a, b) ((a) / (b))
+
+DEFINE_KERNELS(add, vec_add, scalar_add)
+DEFINE_KERNELS(sub, vec_sub, scalar_sub)
+DEFINE_KERNELS(mul, vec_mul, scalar_mul)
+DEFINE_KERNELS(div, vec_div, scalar_div)
+
+typedef void (*KernelVV)(double *, const double *, const double *, size_t);
+typedef void (*KernelVS)(double *, const double *, double, size_t);
+typedef void (*KernelSV)(double *, double, const double *, size_t);
+
+static void mod_vv(double *out, const double *a, const double *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = fmod(a[i], b[i]);
+}
+
+static void mod_vs(double *out, const double *a, double s, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = fmod(a[i], s);
+}
+
+static void mod_sv(double *out, double s, const double *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = fmod(s, b[i]);
+}
+
+static const struct
+{
+    const char *op;
+    KernelVV vv;
+    KernelVS vs;
+    KernelSV sv;
+} kernels[] = {
+    {"+", add_vv, add_vs, add_sv},
+    {"-", sub_vv, sub_vs, sub_sv},
+    {"*", mul_vv, mul_vs, mul_sv},
+    {"/", div_vv, div_vs, div_sv},
+    {"%", mod_vv, mod_vs, mod_sv},
+};
+
+bool array_equals(const ArrayObj *a, const ArrayObj *b)
+{
+    if (a->length != b->length)
+        return false;
+    for (size_t i = 0; i < a->length; i++)
+    {
+        if (a->data[i] != b->data[i])
+            return false;
+    }
+    return true;
+}
+
+RuntimeVal array_binary(RuntimeVal left, RuntimeVal right, char *op)
+{
+    ArrayObj *l = VAL_IS_ARRAY(left) ? (ArrayObj *)VAL_AS_OBJ(left) : NULL;
+    ArrayObj *r = VAL_IS_ARRAY(right) ? (ArrayObj *)VAL_AS_OBJ(right) : NULL;
+    if (!strcmp(op, "=="))
+        return runtimeval_bool(l && r && array_equals(l, r));
+
+    for (size_t k = 0; k < sizeof kernels / sizeof kernels[0]; k++)
+    {
+        if (strcmp(op, kernels[k].op))
+            continue;
+        if (l && r && l->length != r->length)
+        {
+            fprintf(stderr, "Array length mismatch for %s: %zu and %zu.\n", op, l->length, r->length);
+            exit(EXIT_FAILURE);
+        }
+        ArrayObj *out = array_alloc(l ? l->length : r->length);
+        if (l && r)
+            kernels[k].vv(out->data, l->data, r->data, out->length);
+        else if (l)
+            kernels[k].vs(out->data, l->data, VAL_TO_DOUBLE(right), out->length);
+        else
+            kernels[k].sv(out->data, VAL_TO_DOUBLE(left), r->data, out->length);
+        return runtimeval_array(out);
+    }
+
+    fprintf(stderr, "Invalid operation %s for array operands.\n", op);
+    exit(EXIT_FAILURE);
+}
+
+RuntimeVal array_negate(const ArrayObj *arr)
+{
+    ArrayObj *out = array_alloc(arr->length);
+    mul_vs(out->data, arr->data, -1.0, arr->length); // Not 0 - x,which turns 0 into +0 instead of -0.
+    return runtimeval_array(out);
+}
+
+static double horizontal(vec v, int op) // op:'+','<' or '>'.
+{
+    _Alignas(ARRAY_ALIGN) double lanes[VEC_WIDTH];
+    vec_store(lanes, v);
+    double acc = lanes[0];
+    for (int i = 1; i < VEC_WIDTH; i++)
+        acc = op == '+' ? acc + lanes[i] : op == '<' ? fmin(acc, lanes[i]) : fmax(acc, lanes[i]);
+    return acc;
+}
+
+double array_sum(const ArrayObj *arr)
+{
+    vec acc[REDUCE_LANES];
+    for (int j = 0; j < REDUCE_LANES; j++)
+        acc[j] = vec_set1(0.0);
+    size_t i = 0, n = arr->length;
+    for (; i + REDUCE_LANES * VEC_WIDTH <= n; i += REDUCE_LANES * VEC_WIDTH)
+    {
+        for (int j = 0; j < REDUCE_LANES; j++)
+            acc[j] = vec_add(acc[j], vec_load(arr->data + i + j * VEC_WIDTH));
+    }
+    for (int j = 1; j < REDUCE_LANES; j++)
+        acc[0] = vec_add(acc[0], acc[j]);
+    double sum = horizontal(acc[0], '+');
+    for (; i < n; i++)
+        sum += arr->data[i];
+    return sum;
+}
+
+double array_dot(const ArrayObj *a, const ArrayObj *b)
+{
+    if (a->length != b->length)
+    {
+        fprintf(stderr, "Array length mismatch for dot: %zu and %zu.\n", a->length, b->length);
+        exit(EXIT_FAILURE);
+    }
+    vec acc[REDUCE_LANES];
+    for (int j = 0; j < REDUCE_LANES; j++)
+        acc[j] = vec_set1(0.0);
+    size_t i = 0, n = a->length;
+    for (; i + REDUCE_LANES * VEC_WIDTH <= n; i += REDUCE_LANES * VEC_WIDTH)
+    {
+        for (int j = 0; j < REDUCE_LANES; j++)
+            acc[j] = vec_add(acc[j], vec_mul(vec_load(a->data + i + j * VEC_WIDTH), vec_load(b->data + i + j * VEC_WIDTH)));
+    }
+    for (int j = 1; j < REDUCE_LANES; j++)
+        acc[0] = vec_add(acc[0], acc[j]);
+    double sum = horizontal(acc[0], '+');
+    for (; i < n; i++)
+        sum += a->data[i] * b->data[i];
+    return sum;
+}
+
+static double extreme(const ArrayObj *arr, int op, const char *name)
+{
+    if (!arr->length)
+    {
+        fprintf(stderr, "Cannot take %s of an empty array.\n", name);
+        exit(EXIT_FAILURE);
+    }
+    size_t i = 0, n = arr->length;
+    double best = arr->data[0];
+    if (n >= VEC_WIDTH)
+    {
+        vec acc = vec_load(arr->data);
+        if (op == '<')
+        {
+            for (i = VEC_WIDTH; i + VEC_WIDTH <= n; i += VEC_WIDTH)
+                acc = vec_min(acc, vec_load(arr->data + i));
+        }
+        else
+        {
+            for (i = VEC_WIDTH; i + VEC_WIDTH <= n; i += VEC_WIDTH)
+                acc = vec_max(acc, vec_load(arr->data + i));
+        }
+        best = horizontal(acc, op);
+    }
+    for (; i < n; i++)
+        best = op == '<' ? fmin(best, arr->data[i]) : fmax(best, arr->data[i]);
+    return best;
+}
+
+double array_min(const ArrayObj *arr)
+{
+    return extreme(arr, '<', "min");
+}
+
+double array_max(const ArrayObj *arr)
+{
+    return extreme(arr, '>', "max");
+}
+
+void dump_array(const ArrayObj *arr)
+{
+    printf("[");
+    for (size_t i = 0; i < arr->length; i++)
+    {
+        if (i)
+            printf(", ");
+        print_number(arr->data[i]);
+    }
+    printf("]");
+}
+
+void free_array(ArrayObj *arr)
+{
+    free(arr->data);
+    slab_free(arr);
+}
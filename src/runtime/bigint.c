@@ -0,0 +1,636 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "runtime/values.h"
+#include "runtime/bigint.h"
+#include "runtime/slab.h"
+#include "runtime/scratch.h"
+
+__extension__ typedef unsigned __int128 u128;
+
+#define DECIMAL_CHUNK 10000000000000000000ULL // 10^19,the largest power of ten in a limb.
+#define DECIMAL_CHUNK_DIGITS 19
+#define BIGINT_MAX_SHIFT (INT64_C(1) << 32)
+
+typedef struct
+{
+    const uint64_t *limbs;
+    size_t length;
+    bool negative;
+} Num; // Borrowed view of an integer of either kind.
+
+static Num num_of(RuntimeVal val, uint64_t *small)
+{
+    Num n;
+    if (VAL_IS_INTEGER(val))
+    {
+        int64_t i = VAL_AS_INTEGER(val);
+        *small = i < 0 ? 0 - (uint64_t)i : (uint64_t)i;
+        n.limbs = small;
+        n.length = i != 0;
+        n.negative = i < 0;
+        return n;
+    }
+    BigIntObj *big = (BigIntObj *)VAL_AS_OBJ(val);
+    n.limbs = big->limbs;
+    n.length = big->length;
+    n.negative = big->negative;
+    return n;
+}
+
+// Working limbs are scratch memory,released by the public functions below once the result is built.
+static uint64_t *alloc_limbs(size_t n)
+{
+    return scratch_alloc(sizeof(uint64_t) * (n ? n : 1));
+}
+
+static size_t trim(const uint64_t *limbs, size_t n)
+{
+    while (n && !limbs[n - 1])
+        n--;
+    return n;
+}
+
+static RuntimeVal make_integer(uint64_t *limbs, size_t n, bool negative) // Copies limbs into the result.
+{
+    n = trim(limbs, n);
+    if (n <= 1)
+    {
+        uint64_t mag = n ? limbs[0] : 0;
+        if (mag <= (uint64_t)INT64_MAX || (negative && mag == (uint64_t)1 << 63))
+            return runtimeval_integer(negative ? (int64_t)(0 - mag) : (int64_t)mag);
+    }
+    BigIntObj *big = slab_alloc(sizeof(BigIntObj) + sizeof(uint64_t) * n);
+    if (!big)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating integer of %zu limbs.\n", n);
+        exit(EXIT_FAILURE);
+    }
+    big->obj.refcount = 1;
+    big->obj.kind = OBJ_BigInt;
+    big->negative = negative;
+    big->length = n;
+    memcpy(big->limbs, limbs, sizeof(uint64_t) * n);
+    return runtimeval_obj(&big->obj);
+}
+
+static int mag_cmp(const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+    an = trim(a, an);
+    bn = trim(b, bn);
+    if (an != bn)
+        return an < bn ? -1 : 1;
+    for (size_t i = an; i-- > 0;)
+    {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static void mag_add(uint64_t *r, const uint64_t *a, size_t an, const uint64_t *b, size_t bn) // r has max(an,bn)+1 limbs.
+{
+    if (an < bn)
+    {
+        const uint64_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < bn; i++)
+    {
+        u128 s = (u128)a[i] + b[i] + carry;
+        r[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    for (; i < an; i++)
+    {
+        r[i] = a[i] + carry;
+        carry = carry && !r[i];
+    }
+    r[an] = carry;
+}
+
+static uint64_t add_into(uint64_t *r, size_t rn, const uint64_t *b, size_t bn) // r += b,bn <= rn.Returns the carry out.
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < bn; i++)
+    {
+        u128 s = (u128)r[i] + b[i] + carry;
+        r[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    for (; carry && i < rn; i++)
+    {
+        r[i] += 1;
+        carry = !r[i];
+    }
+    return carry;
+}
+
+static uint64_t sub_into(uint64_t *r, size_t rn, const uint64_t *b, size_t bn) // r -= b,bn <= rn.Returns the borrow out.
+{
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < bn; i++)
+    {
+        uint64_t bi = b[i] + borrow;
+        uint64_t next = (bi < borrow) || (r[i] < bi);
+        r[i] -= bi;
+        borrow = next;
+    }
+    for (; borrow && i < rn; i++)
+    {
+        borrow = !r[i];
+        r[i] -= 1;
+    }
+    return borrow;
+}
+
+static void mul_basecase(uint64_t *r, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+    memset(r, 0, sizeof(uint64_t) * (an + bn));
+    for (size_t i = 0; i < an; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++)
+        {
+            u128 t = (u128)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        r[i + bn] = carry;
+    }
+}
+
+// r gets all an+bn limbs of a*b,and must not overlap a or b.
+static void mag_mul(uint64_t *r, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+    if (an < bn)
+    {
+        const uint64_t *t = a;
+        a = b;
+        b = t;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn < KARATSUBA_THRESHOLD)
+    {
+        mul_basecase(r, a, an, b, bn);
+        return;
+    }
+    if (an >= 2 * bn)
+    {
+        // Unbalanced:multiply b by bn limb slices of a.
+        ScratchMark mark = scratch_mark();
+        uint64_t *tmp = alloc_limbs(2 * bn);
+        memset(r, 0, sizeof(uint64_t) * (an + bn));
+        for (size_t i = 0; i < an; i += bn)
+        {
+            size_t chunk = an - i < bn ? an - i : bn;
+            mag_mul(tmp, a + i, chunk, b, bn);
+            add_into(r + i, an + bn - i, tmp, chunk + bn);
+        }
+        scratch_release(mark);
+        return;
+    }
+
+    // a = a1*B^h + a0,b = b1*B^h + b0,and a*b = z2*B^2h + z1*B^h + z0 with
+    // z1 = (a0+a1)(b0+b1) - z0 - z2:three half size products instead of four.
+    size_t h = an / 2; // bn > h,so b1 is never empty.
+    size_t a1n = an - h, b1n = bn - h;
+    mag_mul(r, a, h, b, h);
+    mag_mul(r + 2 * h, a + h, a1n, b + h, b1n);
+
+    size_t sn = a1n + 1, tn = (b1n > h ? b1n : h) + 1;
+    ScratchMark mark = scratch_mark(); // Released per level,or the temporaries of the whole recursion would pile up.
+    uint64_t *sa = alloc_limbs(sn), *sb = alloc_limbs(tn), *z1 = alloc_limbs(sn + tn);
+    mag_add(sa, a + h, a1n, a, h);
+    mag_add(sb, b + h, b1n, b, h);
+    mag_mul(z1, sa, sn, sb, tn);
+    sub_into(z1, sn + tn, r, 2 * h);
+    sub_into(z1, sn + tn, r + 2 * h, a1n + b1n);
+    add_into(r + h, an + bn - h, z1, trim(z1, sn + tn));
+    scratch_release(mark);
+}
+
+// Knuth's algorithm D.q gets an-bn+1 limbs,rem gets bn limbs.an >= bn and b[bn-1] != 0.
+static void mag_divmod(uint64_t *q, uint64_t *rem, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+    if (bn == 1)
+    {
+        uint64_t r = 0;
+        for (size_t i = an; i-- > 0;)
+        {
+            u128 t = ((u128)r << 64) | a[i];
+            q[i] = (uint64_t)(t / b[0]);
+            r = (uint64_t)(t % b[0]);
+        }
+        rem[0] = r;
+        return;
+    }
+
+    // Normalize so the divisor's top bit is set,which keeps each estimated quotient limb at most 2 too big.
+    int s = __builtin_clzll(b[bn - 1]);
+    ScratchMark mark = scratch_mark();
+    uint64_t *vn = alloc_limbs(bn), *un = alloc_limbs(an + 1);
+    for (size_t i = bn - 1; i > 0; i--)
+        vn[i] = (b[i] << s) | (s ? b[i - 1] >> (64 - s) : 0);
+    vn[0] = b[0] << s;
+    un[an] = s ? a[an - 1] >> (64 - s) : 0;
+    for (size_t i = an - 1; i > 0; i--)
+        un[i] = (a[i] << s) | (s ? a[i - 1] >> (64 - s) : 0);
+    un[0] = a[0] << s;
+
+    const u128 base = (u128)1 << 64;
+    for (size_t j = an - bn + 1; j-- > 0;)
+    {
+        u128 num = ((u128)un[j + bn] << 64) | un[j + bn - 1];
+        u128 qhat = num / vn[bn - 1];
+        u128 rhat = num % vn[bn - 1];
+        while (qhat >= base || qhat * vn[bn - 2] > ((rhat << 64) | un[j + bn - 2]))
+        {
+            qhat--;
+            rhat += vn[bn - 1];
+            if (rhat >= base)
+                break;
+        }
+
+        uint64_t k = 0;
+        for (size_t i = 0; i < bn; i++)
+        {
+            u128 p = qhat * vn[i] + k; // Cannot overflow:(2^64-1)^2 + 2^64-1 < 2^128.
+            uint64_t lo = (uint64_t)p;
+            uint64_t borrow = un[i + j] < lo;
+            un[i + j] -= lo;
+            k = (uint64_t)(p >> 64) + borrow;
+        }
+        uint64_t borrow = un[j + bn] < k;
+        un[j + bn] -= k;
+
+        q[j] = (uint64_t)qhat;
+        if (borrow)
+        {
+            // Estimate was one too big,add the divisor back.
+            q[j]--;
+            un[j + bn] += add_into(un + j, bn, vn, bn);
+        }
+    }
+
+    for (size_t i = 0; i < bn; i++)
+        rem[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+    scratch_release(mark);
+}
+
+static RuntimeVal num_add(Num a, Num b)
+{
+    if (a.negative == b.negative)
+    {
+        size_t n = (a.length > b.length ? a.length : b.length) + 1;
+        uint64_t *r = alloc_limbs(n);
+        mag_add(r, a.limbs, a.length, b.limbs, b.length);
+        return make_integer(r, n, a.negative);
+    }
+    if (mag_cmp(a.limbs, a.length, b.limbs, b.length) < 0)
+    {
+        Num t = a;
+        a = b;
+        b = t;
+    }
+    uint64_t *r = alloc_limbs(a.length);
+    memcpy(r, a.limbs, sizeof(uint64_t) * a.length);
+    sub_into(r, a.length, b.limbs, b.length);
+    return make_integer(r, a.length, a.negative);
+}
+
+static RuntimeVal num_mul(Num a, Num b)
+{
+    if (!a.length || !b.length)
+        return runtimeval_integer(0);
+    uint64_t *r = alloc_limbs(a.length + b.length);
+    mag_mul(r, a.limbs, a.length, b.limbs, b.length);
+    return make_integer(r, a.length + b.length, a.negative != b.negative);
+}
+
+static double num_to_double(Num a)
+{
+    if (!a.length)
+        return 0;
+    double d = (double)a.limbs[a.length - 1];
+    if (a.length > 1)
+        d = d * 18446744073709551616.0 + (double)a.limbs[a.length - 2];
+    if (a.length > 2)
+    {
+        size_t shift = 64 * (a.length - 2);
+        d = ldexp(d, shift > 4096 ? 4096 : (int)shift); // Anything past 1024 is inf anyway.
+    }
+    return a.negative ? -d : d;
+}
+
+double bigint_to_double(const BigIntObj *big)
+{
+    Num n = {big->limbs, big->length, big->negative};
+    return num_to_double(n);
+}
+
+// Truncating division,like C:the quotient rounds toward zero and the remainder takes the dividend's sign.
+static void num_divmod(Num a, Num b, RuntimeVal *quot, RuntimeVal *rem)
+{
+    if (mag_cmp(a.limbs, a.length, b.limbs, b.length) < 0)
+    {
+        if (quot)
+            *quot = runtimeval_integer(0);
+        if (rem)
+        {
+            uint64_t *r = alloc_limbs(a.length);
+            memcpy(r, a.limbs, sizeof(uint64_t) * a.length);
+            *rem = make_integer(r, a.length, a.negative);
+        }
+        return;
+    }
+    uint64_t *q = alloc_limbs(a.length - b.length + 1), *r = alloc_limbs(b.length);
+    mag_divmod(q, r, a.limbs, a.length, b.limbs, b.length);
+    if (quot)
+        *quot = make_integer(q, a.length - b.length + 1, a.negative != b.negative);
+    if (rem)
+        *rem = make_integer(r, b.length, a.negative);
+}
+
+static void negate_limbs(uint64_t *t, size_t n)
+{
+    uint64_t carry = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t v = ~t[i] + carry;
+        carry = carry && !v;
+        t[i] = v;
+    }
+}
+
+static uint64_t *to_twos_complement(Num a, size_t n)
+{
+    uint64_t *t = alloc_limbs(n);
+    memcpy(t, a.limbs, sizeof(uint64_t) * a.length);
+    memset(t + a.length, 0, sizeof(uint64_t) * (n - a.length));
+    if (a.negative)
+        negate_limbs(t, n);
+    return t;
+}
+
+static RuntimeVal num_bitwise(Num a, Num b, char op)
+{
+    size_t n = (a.length > b.length ? a.length : b.length) + 1; // One spare limb for the sign.
+    uint64_t *x = to_twos_complement(a, n), *y = to_twos_complement(b, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = op == '&' ? x[i] & y[i] : op == '|' ? x[i] | y[i] : x[i] ^ y[i];
+    }
+    bool negative = x[n - 1] >> 63;
+    if (negative)
+        negate_limbs(x, n);
+    return make_integer(x, n, negative);
+}
+
+static RuntimeVal num_shift_left(Num a, uint64_t count)
+{
+    size_t words = count / 64, bits = count % 64;
+    size_t n = a.length + words + 1;
+    uint64_t *r = alloc_limbs(n);
+    memset(r, 0, sizeof(uint64_t) * n);
+    for (size_t i = 0; i < a.length; i++)
+    {
+        r[i + words] |= a.limbs[i] << bits;
+        r[i + words + 1] = bits ? a.limbs[i] >> (64 - bits) : 0;
+    }
+    return make_integer(r, n, a.negative);
+}
+
+static size_t mag_shift_right(uint64_t *r, const uint64_t *a, size_t an, uint64_t count) // r has an limbs.
+{
+    if (count / 64 >= an)
+        return 0;
+    size_t words = count / 64, bits = count % 64, n = an - words;
+    for (size_t i = 0; i < n; i++)
+    {
+        r[i] = a[i + words] >> bits;
+        if (bits && i + words + 1 < an)
+            r[i] |= a[i + words + 1] << (64 - bits);
+    }
+    return n;
+}
+
+static RuntimeVal num_shift_right(Num a, uint64_t count)
+{
+    // Arithmetic shift rounds toward -infinity:for negative a it is -(((|a|-1) >> count) + 1).
+    uint64_t one = 1;
+    uint64_t *r = alloc_limbs(a.length + 1);
+    if (!a.negative)
+        return make_integer(r, mag_shift_right(r, a.limbs, a.length, count), false);
+    uint64_t *m = alloc_limbs(a.length);
+    memcpy(m, a.limbs, sizeof(uint64_t) * a.length);
+    sub_into(m, a.length, &one, 1);
+    size_t n = mag_shift_right(r, m, a.length, count);
+    r[n] = 0;
+    add_into(r, n + 1, &one, 1);
+    return make_integer(r, n + 1, true);
+}
+
+static int num_cmp(Num a, Num b)
+{
+    if (a.negative != b.negative)
+        return a.negative ? -1 : 1;
+    int c = mag_cmp(a.limbs, a.length, b.limbs, b.length);
+    return a.negative ? -c : c;
+}
+
+static RuntimeVal binary(RuntimeVal left, RuntimeVal right, char *op)
+{
+    uint64_t ls, rs;
+    Num a = num_of(left, &ls), b = num_of(right, &rs);
+    switch (op[0])
+    {
+    case '+':
+        return num_add(a, b);
+    case '-':
+        b.negative = b.length && !b.negative;
+        return num_add(a, b);
+    case '*':
+        return num_mul(a, b);
+    case '/':
+    {
+        if (!b.length)
+            return runtimeval_number(num_to_double(a) / 0.0);
+        RuntimeVal q, r;
+        num_divmod(a, b, &q, &r);
+        if (VAL_IS_INTEGER(r) && VAL_AS_INTEGER(r) == 0)
+            return q;
+        free_value(&q);
+        free_value(&r);
+        return runtimeval_number(num_to_double(a) / num_to_double(b)); // Non-integral,same as with int64_t.
+    }
+    case '%':
+    {
+        if (!b.length)
+        {
+            fprintf(stderr, "Modulo by zero.\n");
+            exit(EXIT_FAILURE);
+        }
+        RuntimeVal r;
+        num_divmod(a, b, NULL, &r);
+        return r;
+    }
+    case '&':
+    case '|':
+    case '^':
+        return num_bitwise(a, b, op[0]);
+    case '=':
+        if (op[1] == '=')
+            return runtimeval_bool(num_cmp(a, b) == 0);
+        break;
+    case '<':
+    case '>':
+        if (op[1] == op[0])
+        {
+            if (b.negative)
+            {
+                fprintf(stderr, "Negative shift count.\n");
+                exit(EXIT_FAILURE);
+            }
+            if (op[0] == '>')
+                return b.length > 1 ? runtimeval_integer(a.negative ? -1 : 0) : num_shift_right(a, b.length ? b.limbs[0] : 0);
+            if (b.length > 1 || (b.length && b.limbs[0] > (uint64_t)BIGINT_MAX_SHIFT))
+            {
+                fprintf(stderr, "Shift count too large.\n");
+                exit(EXIT_FAILURE);
+            }
+            return a.length ? num_shift_left(a, b.length ? b.limbs[0] : 0) : runtimeval_integer(0);
+        }
+        {
+            int c = num_cmp(a, b);
+            if (op[0] == '<')
+                return runtimeval_bool(op[1] == '=' ? c <= 0 : c < 0);
+            return runtimeval_bool(op[1] == '=' ? c >= 0 : c > 0);
+        }
+    default:
+        break;
+    }
+
+    fprintf(stderr, "Invalid operation %s for operand types: \"integer\" and \"integer\"\n", op);
+    exit(EXIT_FAILURE);
+}
+
+RuntimeVal bigint_binary(RuntimeVal left, RuntimeVal right, char *op)
+{
+    ScratchMark mark = scratch_mark();
+    RuntimeVal ret = binary(left, right, op);
+    scratch_release(mark);
+    return ret;
+}
+
+RuntimeVal bigint_negate(RuntimeVal val)
+{
+    uint64_t small;
+    Num a = num_of(val, &small);
+    ScratchMark mark = scratch_mark();
+    uint64_t *r = alloc_limbs(a.length);
+    memcpy(r, a.limbs, sizeof(uint64_t) * a.length);
+    RuntimeVal ret = make_integer(r, a.length, a.length && !a.negative);
+    scratch_release(mark);
+    return ret;
+}
+
+RuntimeVal bigint_not(RuntimeVal val)
+{
+    // ~x == -x - 1
+    RuntimeVal neg = bigint_negate(val);
+    RuntimeVal one = runtimeval_integer(1);
+    RuntimeVal ret = bigint_binary(neg, one, "-");
+    free_value(&neg);
+    return ret;
+}
+
+RuntimeVal bigint_from_decimal(const char *digits)
+{
+    size_t len = strlen(digits);
+    size_t cap = len / DECIMAL_CHUNK_DIGITS + 2, n = 0;
+    ScratchMark mark = scratch_mark();
+    uint64_t *r = alloc_limbs(cap);
+    size_t first = len % DECIMAL_CHUNK_DIGITS ? len % DECIMAL_CHUNK_DIGITS : DECIMAL_CHUNK_DIGITS;
+    for (size_t pos = 0; pos < len;)
+    {
+        size_t take = pos ? DECIMAL_CHUNK_DIGITS : first;
+        uint64_t chunk = 0, scale = 1;
+        for (size_t i = 0; i < take; i++)
+        {
+            chunk = chunk * 10 + (uint64_t)(digits[pos + i] - '0');
+            scale *= 10;
+        }
+        pos += take;
+        // r = r*scale + chunk
+        uint64_t carry = chunk;
+        for (size_t i = 0; i < n; i++)
+        {
+            u128 t = (u128)r[i] * scale + carry;
+            r[i] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        if (carry)
+            r[n++] = carry;
+    }
+    RuntimeVal ret = make_integer(r, n, false);
+    scratch_release(mark);
+    return ret;
+}
+
+RuntimeVal bigint_from_double(double d)
+{
+    int exp;
+    double m = frexp(fabs(d), &exp); // |d| = m * 2^exp,0.5 <= m < 1.
+    if (exp <= 63)
+        return runtimeval_integer((int64_t)d);
+    uint64_t mant = (uint64_t)ldexp(m, 64); // Exact,doubles have 53 bits of mantissa.
+    Num a = {&mant, 1, d < 0};
+    ScratchMark mark = scratch_mark();
+    RuntimeVal ret = num_shift_left(a, (uint64_t)exp - 64);
+    scratch_release(mark);
+    return ret;
+}
+
+char *bigint_to_decimal(const BigIntObj *big)
+{
+    // Peel off 19 digits at a time from the low end.
+    size_t n = big->length;
+    uint64_t *t = alloc_limbs(n);
+    memcpy(t, big->limbs, sizeof(uint64_t) * n);
+    size_t chunkscap = n * 64 / 63 + 2, chunkslen = 0;
+    uint64_t *chunks = alloc_limbs(chunkscap);
+    while (n)
+    {
+        uint64_t r = 0;
+        for (size_t i = n; i-- > 0;)
+        {
+            u128 x = ((u128)r << 64) | t[i];
+            t[i] = (uint64_t)(x / DECIMAL_CHUNK);
+            r = (uint64_t)(x % DECIMAL_CHUNK);
+        }
+        chunks[chunkslen++] = r;
+        n = trim(t, n);
+    }
+
+    char *out = scratch_alloc(chunkslen * DECIMAL_CHUNK_DIGITS + 2);
+    char *p = out;
+    if (big->negative)
+        *p++ = '-';
+    p += sprintf(p, "%" PRIu64, chunks[chunkslen - 1]);
+    for (size_t i = chunkslen - 1; i-- > 0;)
+        p += sprintf(p, "%019" PRIu64, chunks[i]);
+    return out;
+}
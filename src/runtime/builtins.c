@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "runtime/values.h"
+#include "runtime/array.h"
+#include "runtime/builtins.h"
+#include "runtime/collections.h"
+#include "runtime/map.h"
+#include "runtime/interpreter.h"
+#include "runtime/text.h"
+#include "runtime/mathlib.h"
+
+static ArrayObj *expect_array(RuntimeVal *args, size_t i, const char *name)
+{
+    if (!VAL_IS_ARRAY(args[i]))
+    {
+        fprintf(stderr, "Argument %zu of %s must be an array.\n", i + 1, name);
+        exit(EXIT_FAILURE);
+    }
+    return (ArrayObj *)VAL_AS_OBJ(args[i]);
+}
+
+static StringVal expect_string(RuntimeVal *args, size_t i, const char *name) // A view of args[i],which the caller keeps alive.
+{
+    if (!VAL_IS_STRING(args[i]))
+    {
+        fprintf(stderr, "Argument %zu of %s must be a string.\n", i + 1, name);
+        exit(EXIT_FAILURE);
+    }
+    return VAL_AS_STRING(&args[i]);
+}
+
+static RuntimeVal builtin_len(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    if (VAL_IS_STRING(args[0]))
+        return runtimeval_integer((int64_t)VAL_STRING_LENGTH(args[0]));
+    if (VAL_IS_MAP(args[0]))
+        return runtimeval_integer((int64_t)((MapObj *)VAL_AS_OBJ(args[0]))->length);
+    return runtimeval_integer((int64_t)expect_array(args, 0, "len")->length);
+}
+
+static RuntimeVal builtin_sum(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_number(array_sum(expect_array(args, 0, "sum")));
+}
+
+static RuntimeVal builtin_min(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_number(array_min(expect_array(args, 0, "min")));
+}
+
+static RuntimeVal builtin_max(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_number(array_max(expect_array(args, 0, "max")));
+}
+
+static RuntimeVal builtin_dot(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_number(array_dot(expect_array(args, 0, "dot"), expect_array(args, 1, "dot")));
+}
+
+static RuntimeVal builtin_has(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    if (!VAL_IS_MAP(args[0]))
+    {
+        fprintf(stderr, "Argument 1 of has must be a map.\n");
+        exit(EXIT_FAILURE);
+    }
+    return runtimeval_bool(map_find((MapObj *)VAL_AS_OBJ(args[0]), args[1]) != NULL);
+}
+
+// delete(m, k) removes k from the map in variable m,true if it was there.
+static RuntimeVal builtin_delete(Expr **args, size_t argc, Scope *scope)
+{
+    (void)argc;
+    if (args[0]->kind != EXPR_Identifier)
+    {
+        fprintf(stderr, "Argument 1 of delete must be a map variable.\n");
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal key = eval_expr(args[1], scope);
+    RuntimeVal fresh;
+    MapObj *map = (MapObj *)obj_for_update(scope, &args[0]->data.i, OBJ_Map, &fresh);
+    bool removed = map_delete(map, key);
+    free_value(&key);
+    if (!VAL_IS_NULL(fresh))
+    {
+        RuntimeVal stored = setvar_id(scope, &args[0]->data.i, fresh);
+        free_value(&stored);
+    }
+    return runtimeval_bool(removed);
+}
+
+// find(s, sub) is the byte offset of the first sub in s,or -1.
+static RuntimeVal builtin_find(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    size_t at = text_find(expect_string(args, 0, "find"), expect_string(args, 1, "find"));
+    return runtimeval_integer(at == TEXT_NOT_FOUND ? -1 : (int64_t)at);
+}
+
+static RuntimeVal builtin_contains(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_bool(text_find(expect_string(args, 0, "contains"), expect_string(args, 1, "contains")) != TEXT_NOT_FOUND);
+}
+
+static RuntimeVal builtin_count(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    return runtimeval_integer((int64_t)text_count(expect_string(args, 0, "count"), expect_string(args, 1, "count")));
+}
+
+static RuntimeVal builtin_split(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    expect_string(args, 0, "split");
+    return text_split(args[0], expect_string(args, 1, "split"));
+}
+
+static RuntimeVal builtin_replace(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    expect_string(args, 0, "replace");
+    return text_replace(args[0], expect_string(args, 1, "replace"), expect_string(args, 2, "replace"));
+}
+
+static RuntimeVal builtin_starts_with(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    StringVal str = expect_string(args, 0, "starts_with");
+    StringVal prefix = expect_string(args, 1, "starts_with");
+    return runtimeval_bool(prefix.length <= str.length && !memcmp(str.chars, prefix.chars, prefix.length));
+}
+
+// Math builtins have no fn,calls to them go through math_call1/math_call2.
+#define MATH1(name, fn, kernel) {name, 1, NULL, NULL, 0, fn, NULL, kernel, 0}
+#define MATH2(name, fn) {name, 2, NULL, NULL, 0, NULL, fn, NULL, 0}
+
+static const Builtin builtins[] = {
+    {"len", 1, builtin_len, NULL, 0, NULL, NULL, NULL, 0},
+    {"sum", 1, builtin_sum, NULL, 0, NULL, NULL, NULL, 0},
+    {"min", 1, builtin_min, NULL, 0, NULL, NULL, NULL, 0},
+    {"max", 1, builtin_max, NULL, 0, NULL, NULL, NULL, 0},
+    {"dot", 2, builtin_dot, NULL, 0, NULL, NULL, NULL, 0},
+    {"map", 3, NULL, collection_map, 0, NULL, NULL, NULL, 1},
+    {"filter", 3, NULL, collection_filter, 0, NULL, NULL, NULL, 1},
+    {"reduce", 4, NULL, collection_reduce, 0, NULL, NULL, NULL, 2},
+    {"sort", 1, collection_sort, NULL, 0, NULL, NULL, NULL, 0},
+    {"has", 2, builtin_has, NULL, 0, NULL, NULL, NULL, 0},
+    {"delete", 2, NULL, builtin_delete, 1, NULL, NULL, NULL, 0},
+    {"find", 2, builtin_find, NULL, 0, NULL, NULL, NULL, 0},
+    {"contains", 2, builtin_contains, NULL, 0, NULL, NULL, NULL, 0},
+    {"count", 2, builtin_count, NULL, 0, NULL, NULL, NULL, 0},
+    {"split", 2, builtin_split, NULL, 0, NULL, NULL, NULL, 0},
+    {"replace", 3, builtin_replace, NULL, 0, NULL, NULL, NULL, 0},
+    {"starts_with", 2, builtin_starts_with, NULL, 0, NULL, NULL, NULL, 0},
+    MATH1("sqrt", sqrt, math_kernel_sqrt),
+    MATH1("cbrt", cbrt, NULL),
+    MATH1("exp", exp, math_kernel_exp),
+    MATH1("log", log, math_kernel_log),
+    MATH1("log2", log2, NULL),
+    MATH1("log10", log10, NULL),
+    MATH1("sin", sin, math_kernel_sin),
+    MATH1("cos", cos, math_kernel_cos),
+    MATH1("tan", tan, NULL),
+    MATH1("asin", asin, NULL),
+    MATH1("acos", acos, NULL),
+    MATH1("atan", atan, NULL),
+    MATH1("sinh", sinh, NULL),
+    MATH1("cosh", cosh, NULL),
+    MATH1("tanh", tanh, NULL),
+    MATH1("abs", fabs, math_kernel_abs),
+    MATH1("floor", floor, math_kernel_floor),
+    MATH1("ceil", ceil, math_kernel_ceil),
+    MATH1("round", round, math_kernel_round),
+    MATH1("trunc", trunc, math_kernel_trunc),
+    MATH2("pow", pow),
+    MATH2("atan2", atan2),
+    MATH2("hypot", hypot),
+};
+
+const Builtin *find_builtin(const char *name)
+{
+    for (size_t i = 0; i < sizeof builtins / sizeof builtins[0]; i++)
+    {
+        if (!strcmp(builtins[i].name, name))
+            return &builtins[i];
+    }
+    return NULL;
+}
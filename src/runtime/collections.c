@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "frontend/ast.h"
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "runtime/interpreter.h"
+#include "runtime/parallel.h"
+#include "runtime/reactive.h"
+#include "runtime/threadpool.h"
+#include "runtime/array.h"
+#include "runtime/collections.h"
+#include "runtime/scratch.h"
+
+#define NO_BAD SIZE_MAX
+
+// The names an expression argument sees its operands as,in a scope of their own above the caller's.
+typedef struct
+{
+    Scope local;
+    size_t n;
+} Binder;
+
+static char *binder_name(Expr *arg, const char *fn)
+{
+    if (arg->kind != EXPR_Identifier)
+    {
+        fprintf(stderr, "%s expects a variable name to bind each element to.\n", fn);
+        exit(EXIT_FAILURE);
+    }
+    return arg->data.i.symbol;
+}
+
+static void bind_init(Binder *b, Scope *scope, char **names, size_t n)
+{
+    b->local = new_scope(scope);
+    b->n = n;
+    for (size_t i = 0; i < n; i++)
+        declarevar(&b->local, names[i], runtimeval_number(0), 0);
+}
+
+static RuntimeVal bind_eval(Binder *b, Expr *body, const double *operands)
+{
+    for (size_t i = 0; i < b->n; i++)
+    {
+        free_value(&b->local.values[i]); // The expression may have assigned something else.
+        b->local.values[i] = runtimeval_number(operands[i]);
+    }
+    return eval_expr(body, &b->local);
+}
+
+static void bind_free(Binder *b)
+{
+    if (b->local.cells) // Reactive mode tracked reads of the names.
+    {
+        for (size_t i = 0; i < b->local.len; i++)
+        {
+            if (b->local.cells[i])
+                cell_release(b->local.cells[i]);
+        }
+    }
+    free_scope(&b->local);
+}
+
+typedef struct
+{
+    const ArrayObj *in;
+    Expr *body;
+    Scope *scope;
+    char *names[2];
+    size_t nnames;
+    double *out; // map:the result,filter:kept elements at their chunk's offset.
+    size_t *counts; // filter:elements kept per chunk.
+    double *partials; // reduce:one per chunk.
+    size_t *bad; // Per chunk,the first element whose result had the wrong type.
+    ScratchMark mark; // The buffers above are scratch,given back when the builtin returns.
+} Job;
+
+static size_t chunk_count(size_t length)
+{
+    return (length + COLLECTION_CHUNK - 1) / COLLECTION_CHUNK;
+}
+
+static void chunk_bounds(const Job *job, size_t c, size_t *lo, size_t *hi)
+{
+    *lo = c * COLLECTION_CHUNK;
+    *hi = *lo + COLLECTION_CHUNK < job->in->length ? *lo + COLLECTION_CHUNK : job->in->length;
+}
+
+// Whether every chunk may run at once:binding the names to NaN keeps analyze from assuming any particular value.
+static int can_parallelize(Job *job, size_t nchunks)
+{
+    if (nchunks < 2 || reactive_enabled || lazy_enabled || threadpool_size(threadpool_global()) < 2)
+        return 0;
+    Binder probe;
+    bind_init(&probe, job->scope, job->names, job->nnames);
+    for (size_t i = 0; i < job->nnames; i++)
+        probe.local.values[i] = runtimeval_number(NAN);
+    int total = expr_is_total(job->body, &probe.local);
+    bind_free(&probe);
+    return total;
+}
+
+static void run_chunks(Job *job, TaskFn fn, size_t nchunks)
+{
+    for (size_t c = 0; c < nchunks; c++)
+        job->bad[c] = NO_BAD;
+    if (can_parallelize(job, nchunks))
+    {
+        threadpool_run(threadpool_global(), fn, job, nchunks);
+        return;
+    }
+    for (size_t c = 0; c < nchunks; c++)
+    {
+        fn(job, c);
+        if (job->bad[c] != NO_BAD)
+            return; // Later chunks could fail differently.
+    }
+}
+
+static size_t first_bad(Job *job, size_t nchunks)
+{
+    for (size_t c = 0; c < nchunks; c++)
+    {
+        if (job->bad[c] != NO_BAD)
+            return job->bad[c];
+    }
+    return NO_BAD;
+}
+
+static void job_init(Job *job, Expr **args, size_t nnames, Scope *scope, const char *fn, RuntimeVal *arr)
+{
+    *arr = eval_expr(args[0], scope);
+    if (!VAL_IS_ARRAY(*arr))
+    {
+        fprintf(stderr, "Argument 1 of %s must be an array.\n", fn);
+        exit(EXIT_FAILURE);
+    }
+    job->in = (ArrayObj *)VAL_AS_OBJ(*arr);
+    job->scope = scope;
+    job->nnames = nnames;
+    for (size_t i = 0; i < nnames; i++)
+        job->names[i] = binder_name(args[1 + i], fn);
+    if (nnames == 2 && !strcmp(job->names[0], job->names[1]))
+    {
+        fprintf(stderr, "%s needs two different names.\n", fn);
+        exit(EXIT_FAILURE);
+    }
+    job->body = args[1 + nnames];
+    job->out = NULL;
+    job->counts = NULL;
+    job->partials = NULL;
+    job->mark = scratch_mark();
+    job->bad = scratch_alloc(sizeof(size_t) * (chunk_count(job->in->length) + 1));
+}
+
+/* ---------- map ---------- */
+
+static void map_task(void *arg, size_t c)
+{
+    Job *job = arg;
+    size_t lo, hi;
+    chunk_bounds(job, c, &lo, &hi);
+    Binder b;
+    bind_init(&b, job->scope, job->names, 1);
+    for (size_t i = lo; i < hi; i++)
+    {
+        RuntimeVal val = bind_eval(&b, job->body, &job->in->data[i]);
+        if (!VAL_IS_NUMERIC(val))
+        {
+            free_value(&val);
+            job->bad[c] = i;
+            break;
+        }
+        job->out[i] = VAL_TO_DOUBLE(val);
+        free_value(&val);
+    }
+    bind_free(&b);
+}
+
+RuntimeVal collection_map(Expr **args, size_t argc, Scope *scope)
+{
+    (void)argc;
+    Job job;
+    RuntimeVal arr;
+    job_init(&job, args, 1, scope, "map", &arr);
+    size_t nchunks = chunk_count(job.in->length);
+    ArrayObj *out = array_alloc(job.in->length);
+    job.out = out->data;
+    run_chunks(&job, map_task, nchunks);
+    size_t bad = first_bad(&job, nchunks);
+    if (bad != NO_BAD)
+    {
+        fprintf(stderr, "map expression must give a number,it did not for element %zu.\n", bad);
+        exit(EXIT_FAILURE);
+    }
+    scratch_release(job.mark);
+    free_value(&arr);
+    return runtimeval_array(out);
+}
+
+/* ---------- filter ---------- */
+
+static void filter_task(void *arg, size_t c)
+{
+    Job *job = arg;
+    size_t lo, hi;
+    chunk_bounds(job, c, &lo, &hi);
+    Binder b;
+    bind_init(&b, job->scope, job->names, 1);
+    size_t kept = 0;
+    for (size_t i = lo; i < hi; i++)
+    {
+        RuntimeVal val = bind_eval(&b, job->body, &job->in->data[i]);
+        if (!VAL_IS_BOOL(val))
+        {
+            free_value(&val);
+            job->bad[c] = i;
+            break;
+        }
+        if (VAL_AS_BOOL(val))
+            job->out[lo + kept++] = job->in->data[i];
+    }
+    job->counts[c] = kept;
+    bind_free(&b);
+}
+
+RuntimeVal collection_filter(Expr **args, size_t argc, Scope *scope)
+{
+    (void)argc;
+    Job job;
+    RuntimeVal arr;
+    job_init(&job, args, 1, scope, "filter", &arr);
+    size_t nchunks = chunk_count(job.in->length);
+    job.out = scratch_alloc(sizeof(double) * (job.in->length + 1));
+    job.counts = scratch_alloc(sizeof(size_t) * (nchunks + 1));
+    run_chunks(&job, filter_task, nchunks);
+    size_t bad = first_bad(&job, nchunks);
+    if (bad != NO_BAD)
+    {
+        fprintf(stderr, "filter condition must give a boolean,it did not for element %zu.\n", bad);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t total = 0;
+    for (size_t c = 0; c < nchunks; c++)
+        total += job.counts[c];
+    ArrayObj *out = array_alloc(total);
+    for (size_t c = 0, at = 0; c < nchunks; c++)
+    {
+        memcpy(out->data + at, job.out + c * COLLECTION_CHUNK, sizeof(double) * job.counts[c]);
+        at += job.counts[c];
+    }
+    scratch_release(job.mark);
+    free_value(&arr);
+    return runtimeval_array(out);
+}
+
+/* ---------- reduce ---------- */
+
+static int reduce_step(Binder *b, Expr *body, double l, double r, double *out)
+{
+    double operands[2] = {l, r};
+    RuntimeVal val = bind_eval(b, body, operands);
+    int ok = VAL_IS_NUMERIC(val);
+    if (ok)
+        *out = VAL_TO_DOUBLE(val);
+    free_value(&val);
+    return ok;
+}
+
+static void reduce_task(void *arg, size_t c)
+{
+    Job *job = arg;
+    size_t lo, hi;
+    chunk_bounds(job, c, &lo, &hi);
+    Binder b;
+    bind_init(&b, job->scope, job->names, 2);
+    double acc = job->in->data[lo];
+    for (size_t i = lo + 1; i < hi; i++)
+    {
+        if (!reduce_step(&b, job->body, acc, job->in->data[i], &acc))
+        {
+            job->bad[c] = i;
+            break;
+        }
+    }
+    job->partials[c] = acc;
+    bind_free(&b);
+}
+
+RuntimeVal collection_reduce(Expr **args, size_t argc, Scope *scope)
+{
+    (void)argc;
+    Job job;
+    RuntimeVal arr;
+    job_init(&job, args, 2, scope, "reduce", &arr);
+    if (!job.in->length)
+    {
+        fprintf(stderr, "Cannot reduce an empty array.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t nchunks = chunk_count(job.in->length);
+    job.partials = scratch_alloc(sizeof(double) * nchunks);
+    run_chunks(&job, reduce_task, nchunks);
+    size_t bad = first_bad(&job, nchunks);
+
+    // Chunk results are combined left to right on this thread.
+    double acc = job.partials[0];
+    if (bad == NO_BAD)
+    {
+        Binder b;
+        bind_init(&b, scope, job.names, 2);
+        for (size_t c = 1; c < nchunks; c++)
+        {
+            if (!reduce_step(&b, job.body, acc, job.partials[c], &acc))
+            {
+                bad = c * COLLECTION_CHUNK;
+                break;
+            }
+        }
+        bind_free(&b);
+    }
+    if (bad != NO_BAD)
+    {
+        fprintf(stderr, "reduce expression must give a number,it did not at element %zu.\n", bad);
+        exit(EXIT_FAILURE);
+    }
+    scratch_release(job.mark);
+    free_value(&arr);
+    return runtimeval_number(acc);
+}
+
+/* ---------- sort ---------- */
+
+// A total order,so the result is the same however the chunks were merged.
+static int compare_doubles(const void *pa, const void *pb)
+{
+    double a = *(const double *)pa, b = *(const double *)pb;
+    if (isnan(a) || isnan(b))
+        return !!isnan(a) - !!isnan(b);
+    if (a != b)
+        return a < b ? -1 : 1;
+    return !!signbit(b) - !!signbit(a);
+}
+
+typedef struct
+{
+    double *src;
+    double *dst;
+    size_t length;
+    size_t width; // Of the sorted runs being merged pairwise.
+} SortJob;
+
+static void sort_chunk_task(void *arg, size_t c)
+{
+    SortJob *job = arg;
+    size_t lo = c * COLLECTION_CHUNK;
+    size_t n = lo + COLLECTION_CHUNK < job->length ? COLLECTION_CHUNK : job->length - lo;
+    qsort(job->src + lo, n, sizeof(double), compare_doubles);
+}
+
+static void merge_task(void *arg, size_t pair)
+{
+    SortJob *job = arg;
+    size_t lo = pair * 2 * job->width;
+    size_t mid = lo + job->width < job->length ? lo + job->width : job->length;
+    size_t hi = mid + job->width < job->length ? mid + job->width : job->length;
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi)
+        job->dst[k++] = compare_doubles(&job->src[j], &job->src[i]) < 0 ? job->src[j++] : job->src[i++];
+    memcpy(job->dst + k, job->src + i, sizeof(double) * (mid - i));
+    k += mid - i;
+    memcpy(job->dst + k, job->src + j, sizeof(double) * (hi - j));
+}
+
+RuntimeVal collection_sort(RuntimeVal *args, size_t argc)
+{
+    (void)argc;
+    if (!VAL_IS_ARRAY(args[0]))
+    {
+        fprintf(stderr, "Argument 1 of sort must be an array.\n");
+        exit(EXIT_FAILURE);
+    }
+    const ArrayObj *in = (ArrayObj *)VAL_AS_OBJ(args[0]);
+    ArrayObj *out = array_alloc(in->length);
+    memcpy(out->data, in->data, sizeof(double) * in->length);
+    size_t nchunks = chunk_count(in->length);
+    if (nchunks < 2)
+    {
+        qsort(out->data, in->length, sizeof(double), compare_doubles);
+        return runtimeval_array(out);
+    }
+
+    ScratchMark mark = scratch_mark();
+    double *tmp = scratch_alloc(sizeof(double) * in->length);
+    SortJob job = {out->data, tmp, in->length, COLLECTION_CHUNK};
+    threadpool_run(threadpool_global(), sort_chunk_task, &job, nchunks);
+    for (; job.width < job.length; job.width *= 2)
+    {
+        threadpool_run(threadpool_global(), merge_task, &job, (job.length + 2 * job.width - 1) / (2 * job.width));
+        double *swap = job.src;
+        job.src = job.dst;
+        job.dst = swap;
+    }
+    if (job.src != out->data)
+        memcpy(out->data, job.src, sizeof(double) * in->length);
+    scratch_release(mark);
+    return runtimeval_array(out);
+}
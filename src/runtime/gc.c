@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "runtime/values.h"
+#include "runtime/rope.h"
+#include "runtime/array.h"
+#include "runtime/map.h"
+#include "runtime/record.h"
+#include "runtime/gc.h"
+#include "runtime/slab.h"
+
+// Per thread,values are freed by whichever thread drops the last reference and the pool threads never share a queue.
+static _Thread_local Obj **queue = NULL;
+static _Thread_local size_t queue_len = 0, queue_cap = 0;
+static _Thread_local size_t budget = GC_UNLIMITED;
+static _Thread_local int draining = 0; // Releases inside a drain only queue,the drain loop picks them up.
+
+static pthread_key_t queue_key; // Its destructor frees the queue of a thread that exits.
+static pthread_once_t queue_once = PTHREAD_ONCE_INIT;
+
+static void free_queue(void *unused)
+{
+    (void)unused;
+    free(queue);
+    queue = NULL;
+    queue_len = queue_cap = 0;
+}
+
+static void make_queue_key(void)
+{
+    pthread_key_create(&queue_key, free_queue);
+}
+
+static void free_obj(Obj *obj)
+{
+    switch (obj->kind)
+    {
+    case OBJ_Integer:
+    case OBJ_String:
+    case OBJ_BigInt:
+        slab_free(obj);
+        break;
+    case OBJ_Rope:
+        free_rope((RopeObj *)obj);
+        break;
+    case OBJ_Slice:
+        obj_decref(((SliceObj *)obj)->base);
+        slab_free(obj);
+        break;
+    case OBJ_Array:
+        free_array((ArrayObj *)obj);
+        break;
+    case OBJ_Map:
+        free_map((MapObj *)obj);
+        break;
+    case OBJ_Record:
+        free_record((RecordObj *)obj);
+        break;
+    default:
+        fprintf(stderr, "Exhaustive handling of ObjType in free_obj.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void drain(size_t limit)
+{
+    draining = 1;
+    // Last in first out,so a deep chain keeps the queue at a single entry.
+    for (size_t freed = 0; queue_len && (limit == GC_UNLIMITED || freed < limit); freed++)
+        free_obj(queue[--queue_len]);
+    draining = 0;
+}
+
+void gc_set_budget(size_t limit)
+{
+    budget = limit;
+}
+
+void gc_release(Obj *obj)
+{
+    if (obj->kind != OBJ_Map && obj->kind != OBJ_Record && obj->kind != OBJ_Rope)
+    {
+        free_obj(obj); // Holds nothing,or at most one reference(a slice's base),so it can't recurse.
+        return;
+    }
+    if (queue_len == queue_cap)
+    {
+        if (!queue)
+        {
+            pthread_once(&queue_once, make_queue_key);
+            pthread_setspecific(queue_key, &queue);
+        }
+        size_t cap = queue_cap ? queue_cap * 2 : 64;
+        Obj **tmp = realloc(queue, sizeof(Obj *) * cap);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened while queueing %zu objects to free.\n", queue_len);
+            exit(EXIT_FAILURE);
+        }
+        queue = tmp;
+        queue_cap = cap;
+    }
+    queue[queue_len++] = obj;
+    if (!draining)
+        drain(budget);
+}
+
+void gc_step(void)
+{
+    if (!draining)
+        drain(budget);
+}
+
+void gc_drain(void)
+{
+    if (!draining)
+        drain(GC_UNLIMITED);
+}
@@ -2,18 +2,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <inttypes.h>
 
 #include "frontend/ast.h"
 #include "runtime/values.h"
 #include "runtime/scope.h"
 #include "runtime/interpreter.h"
+#include "runtime/parallel.h"
+#include "runtime/reactive.h"
+#include "runtime/rope.h"
+#include "runtime/bigint.h"
+#include "runtime/array.h"
+#include "runtime/builtins.h"
+#include "runtime/map.h"
+#include "runtime/record.h"
+#include "runtime/mathlib.h"
+#include "runtime/gc.h"
+#include "runtime/scratch.h"
+#include "runtime/resolver.h"
 
 RuntimeVal eval_program(Program prog, Scope *scope)
 {
     RuntimeVal lastEvaled = runtimeval_null();
-    for (size_t i = 0; i < prog.len; i++)
+    size_t i = 0;
+    resolve_program(prog, scope);
+    while (i < prog.len)
     {
+        size_t end = parallel_segment_end(prog, i);
+        free_value(&lastEvaled);
+        gc_step(); // Between statements,so a budgeted free of something huge keeps making progress.
+        scratch_reset();
+        if (end - i >= 2)
+        {
+            lastEvaled = eval_segment_parallel(prog, i, end, scope);
+            i = end;
+            continue;
+        }
         lastEvaled = eval_stmt(prog.body[i], scope);
+        i++;
     }
     return lastEvaled;
 }
@@ -35,9 +61,19 @@ RuntimeVal eval_stmt(Stmt *stmt, Scope *scope)
 RuntimeVal eval_variable_declaration_stmt(VariableDeclarationStmt vds, Scope *scope)
 {
     if (!vds.value) {
-        return declarevar(scope, vds.ident, runtimeval_null(), 0); // must not be constant.
+        return vds.slot == VAR_UNRESOLVED ? declarevar(scope, vds.ident, runtimeval_null(), 0) : declarevar_at(scope, vds.slot, vds.ident, runtimeval_null(), 0); // must not be constant.
+    }
+    if (reactive_enabled)
+    {
+        return declare_derived(scope, vds.ident, vds.value, vds.isConst);
+    }
+    if (lazy_enabled)
+    {
+        return declare_lazy(scope, vds.ident, vds.value, vds.isConst);
     }
-    return declarevar(scope, vds.ident, eval_expr(vds.value, scope), vds.isConst);
+    if (vds.slot == VAR_UNRESOLVED)
+        return declarevar(scope, vds.ident, eval_expr(vds.value, scope), vds.isConst);
+    return declarevar_at(scope, vds.slot, vds.ident, eval_expr(vds.value, scope), vds.isConst);
 }
 
 RuntimeVal eval_expr(Expr *expr, Scope *scope)
@@ -45,17 +81,31 @@ RuntimeVal eval_expr(Expr *expr, Scope *scope)
     switch (expr->kind)
     {
     case EXPR_NumericLiteral:
-        return runtimeval_number(expr->data.n.x);
+        return expr->data.n.digits ? bigint_from_decimal(expr->data.n.digits) : runtimeval_integer(expr->data.n.x);
     case EXPR_StringLiteral:
         return runtimeval_string(expr->data.s.s);
     case EXPR_Identifier:
-        return getvar(scope, expr->data.i.symbol);
+        return getvar_id(scope, &expr->data.i);
     case EXPR_UnaryExpr:
         return eval_unary_expr(expr->data.ue, scope);
     case EXPR_BinaryExpr:
         return eval_binary_expr(expr->data.be, scope);
     case EXPR_AssignmentExpr:
         return eval_assignment_expr(expr->data.a, scope);
+    case EXPR_ArrayLiteral:
+        return eval_array_literal(expr->data.arr, scope);
+    case EXPR_IndexExpr:
+        return eval_index_expr(expr->data.idx, scope);
+    case EXPR_CallExpr:
+        return eval_call_expr(&expr->data.call, scope);
+    case EXPR_MapLiteral:
+        return eval_map_literal(expr->data.map, scope);
+    case EXPR_MemberExpr:
+        return eval_member_expr(&expr->data.mem, scope);
+    case EXPR_RecordLiteral:
+        return eval_record_literal(&expr->data.rec, scope);
+    case EXPR_TemplateLiteral:
+        return eval_template_literal(expr->data.tpl, scope);
     default:
         fprintf(stderr, "Exhaustive handling of ExprType in eval_expr.\n");
         exit(EXIT_FAILURE);
@@ -68,57 +118,124 @@ RuntimeVal eval_unary_expr(UnaryExpr ue, Scope *scope)
     switch (ue.op)
     {
     case '!':
-        switch (on.type)
+        switch (VAL_TYPE(on))
         {
         case VAL_Number:
-            return runtimeval_bool(!on.data.n.value);
+            return runtimeval_bool(!VAL_AS_NUMBER(on));
+        case VAL_Integer:
+        {
+            bool zero = !VAL_IS_BIGINT(on) && !VAL_AS_INTEGER(on); // Bigints are never 0.
+            free_value(&on);
+            return runtimeval_bool(zero);
+        }
         case VAL_Bool:
-            return runtimeval_bool(!on.data.b.value);
+            return runtimeval_bool(!VAL_AS_BOOL(on));
         case VAL_Null:
             return runtimeval_bool(true);
         case VAL_String:
-            return runtimeval_bool(*on.data.s.value);
+        {
+            bool nonempty = VAL_STRING_LENGTH(on) != 0;
+            free_value(&on);
+            return runtimeval_bool(nonempty);
+        }
+        case VAL_Array:
+            fprintf(stderr, "Cannot perform ! on array value.");
+            exit(EXIT_FAILURE);
+        case VAL_Map:
+            fprintf(stderr, "Cannot perform ! on map value.");
+            exit(EXIT_FAILURE);
+        case VAL_Record:
+            fprintf(stderr, "Cannot perform ! on record value.");
+            exit(EXIT_FAILURE);
         default:
             fprintf(stderr, "Exhaustive handling of ValueType in eval_unary_expr(`!`)");
             exit(EXIT_FAILURE);
         }
         break;
     case '~':
-        switch (on.type)
+        switch (VAL_TYPE(on))
         {
         case VAL_Number:
-            if ((int)on.data.n.value != on.data.n.value)
+        {
+            int64_t i;
+            if (!double_to_int64(VAL_AS_NUMBER(on), &i))
             {
                 fprintf(stderr, "Cannot perform ~ on non-integer value.");
                 exit(EXIT_FAILURE);
             }
-            return runtimeval_number(~(int)(on.data.n.value));
+            return runtimeval_integer(~i);
+        }
+        case VAL_Integer:
+        {
+            if (VAL_IS_BIGINT(on))
+            {
+                RuntimeVal ret = bigint_not(on);
+                free_value(&on);
+                return ret;
+            }
+            int64_t i = VAL_AS_INTEGER(on);
+            free_value(&on);
+            return runtimeval_integer(~i);
+        }
         case VAL_Bool:
-            return runtimeval_bool(!on.data.b.value); // Bitwise not is just logical not for booleans.
+            return runtimeval_bool(!VAL_AS_BOOL(on)); // Bitwise not is just logical not for booleans.
         case VAL_Null:
             fprintf(stderr, "Cannot perform ~ on null value.");
             exit(EXIT_FAILURE);
         case VAL_String:
             fprintf(stderr, "Cannot perform ~ on string value.");
             exit(EXIT_FAILURE);
+        case VAL_Array:
+            fprintf(stderr, "Cannot perform ~ on array value.");
+            exit(EXIT_FAILURE);
+        case VAL_Map:
+            fprintf(stderr, "Cannot perform ~ on map value.");
+            exit(EXIT_FAILURE);
+        case VAL_Record:
+            fprintf(stderr, "Cannot perform ~ on record value.");
+            exit(EXIT_FAILURE);
         default:
             fprintf(stderr, "Exhaustive handling of ValueType in eval_unary_expr(`~`)");
             exit(EXIT_FAILURE);
         }
         break;
     case '-':
-        switch (on.type)
+        switch (VAL_TYPE(on))
         {
         case VAL_Number:
-            return runtimeval_number(-on.data.n.value);
+            return runtimeval_number(-VAL_AS_NUMBER(on));
+        case VAL_Integer:
+        {
+            if (VAL_IS_BIGINT(on) || VAL_AS_INTEGER(on) == INT64_MIN)
+            {
+                RuntimeVal ret = bigint_negate(on);
+                free_value(&on);
+                return ret;
+            }
+            int64_t i = VAL_AS_INTEGER(on);
+            free_value(&on);
+            return runtimeval_integer(-i);
+        }
         case VAL_Bool:
-            return runtimeval_bool(-on.data.b.value); // Bitwise not is just logical not for booleans.
+            return runtimeval_bool(-VAL_AS_BOOL(on)); // Bitwise not is just logical not for booleans.
         case VAL_Null:
             fprintf(stderr, "Cannot perform - on null value.");
             exit(EXIT_FAILURE);
         case VAL_String:
             fprintf(stderr, "Cannot perform - on string value.");
             exit(EXIT_FAILURE);
+        case VAL_Array:
+        {
+            RuntimeVal ret = array_negate((ArrayObj *)VAL_AS_OBJ(on));
+            free_value(&on);
+            return ret;
+        }
+        case VAL_Map:
+            fprintf(stderr, "Cannot perform - on map value.");
+            exit(EXIT_FAILURE);
+        case VAL_Record:
+            fprintf(stderr, "Cannot perform - on record value.");
+            exit(EXIT_FAILURE);
         default:
             fprintf(stderr, "Exhaustive handling of ValueType in eval_unary_expr(`-`)");
             exit(EXIT_FAILURE);
@@ -134,60 +251,294 @@ RuntimeVal eval_binary_expr(BinaryExpr be, Scope *scope)
 {
     RuntimeVal left = eval_expr(be.left, scope);
     RuntimeVal right = eval_expr(be.right, scope);
-    
-    if (left.type == VAL_Null || right.type == VAL_Null)
+    return eval_binary_values(left, right, be.op);
+}
+
+static int is_exact_comparison(RuntimeVal left, RuntimeVal right, char *op)
+{
+    if (!VAL_IS_BIGINT(left) && !VAL_IS_BIGINT(right))
+        return 0;
+    double d = VAL_IS_NUMBER(left) ? VAL_AS_NUMBER(left) : VAL_AS_NUMBER(right);
+    return isfinite(d) && floor(d) == d && (!strcmp(op, "==") || !strcmp(op, "<") || !strcmp(op, ">") || !strcmp(op, "<=") || !strcmp(op, ">="));
+}
+
+static const char *type_name(RuntimeVal val)
+{
+    switch (VAL_TYPE(val))
+    {
+    case VAL_Number:
+        return "number";
+    case VAL_Bool:
+        return "bool";
+    case VAL_String:
+        return "string";
+    case VAL_Null:
+        return "null";
+    case VAL_Integer:
+        return "integer";
+    case VAL_Array:
+        return "array";
+    case VAL_Map:
+        return "map";
+    case VAL_Record:
+        return "record";
+    }
+    return "unknown";
+}
+
+bool values_equal(RuntimeVal left, RuntimeVal right)
+{
+    if (VAL_TYPE(left) != VAL_TYPE(right) && !(VAL_IS_NUMERIC(left) && VAL_IS_NUMERIC(right)))
+        return false;
+    if (VAL_IS_NULL(left))
+        return true; // == on null gives null,but two null entries are the same.
+    RuntimeVal ret = eval_binary_values(copy_value(left), copy_value(right), "==");
+    return VAL_IS_BOOL(ret) && VAL_AS_BOOL(ret);
+}
+
+static bool map_equals(const MapObj *a, const MapObj *b) // The same keys,with equal values.
+{
+    if (a->length != b->length)
+        return false;
+    for (size_t i = 0; i < a->capacity; i++)
+    {
+        if (a->ctrl[i] == MAP_EMPTY)
+            continue;
+        RuntimeVal *value = map_find(b, a->slots[i].key);
+        if (!value || !values_equal(a->slots[i].value, *value))
+            return false;
+    }
+    return true;
+}
+
+static bool record_equals(const RecordObj *a, const RecordObj *b) // The same fields,with equal values.
+{
+    if (a->shape->nfields != b->shape->nfields)
+        return false;
+    for (size_t i = 0; i < a->shape->nfields; i++)
+    {
+        size_t j = i;
+        if (a->shape != b->shape) // Added in another order,look the name up.
+        {
+            for (j = 0; j < b->shape->nfields && strcmp(a->shape->names[i], b->shape->names[j]); j++)
+                ;
+            if (j == b->shape->nfields)
+                return false;
+        }
+        if (!values_equal(a->slots[i], b->slots[j]))
+            return false;
+    }
+    return true;
+}
+
+RuntimeVal eval_binary_values(RuntimeVal left, RuntimeVal right, char *op)
+{
+    if (VAL_IS_SMALL_INTEGER(left) && VAL_IS_SMALL_INTEGER(right))
     {
+        // Hot path:no boxes to unwrap or free.
+        return eval_integer_binary_expr((IntegerVal){VAL_AS_SMALL_INTEGER(left)}, (IntegerVal){VAL_AS_SMALL_INTEGER(right)}, op);
+    }
+
+    if (VAL_IS_NULL(left) || VAL_IS_NULL(right))
+    {
+        free_value(&left);
+        free_value(&right);
         return runtimeval_null();
     }
 
-    if (left.type == VAL_Number && right.type == VAL_Number)
+    if (VAL_IS_NUMBER(left) && VAL_IS_NUMBER(right))
     {
-        return eval_numeric_binary_expr(left.data.n, right.data.n, be.op);
+        return eval_numeric_binary_expr((NumberVal){VAL_AS_NUMBER(left)}, (NumberVal){VAL_AS_NUMBER(right)}, op);
     }
 
-    if (left.type == VAL_Bool && right.type == VAL_Bool)
+    if (VAL_IS_NUMERIC(left) && VAL_IS_NUMERIC(right))
     {
-        return eval_bool_binary_expr(left.data.b, right.data.b, be.op);
+        RuntimeVal ret;
+        if (VAL_IS_INTEGER(left) && VAL_IS_INTEGER(right))
+        {
+            ret = eval_integer_binary_expr((IntegerVal){VAL_AS_INTEGER(left)}, (IntegerVal){VAL_AS_INTEGER(right)}, op);
+        }
+        else if (VAL_IS_ANY_INTEGER(left) && VAL_IS_ANY_INTEGER(right))
+        {
+            ret = bigint_binary(left, right, op);
+        }
+        else if (is_exact_comparison(left, right, op))
+        {
+            // A bigint against an integral double:compare exactly,doubles past 2^53 can't tell neighbours apart.
+            RuntimeVal l = VAL_IS_NUMBER(left) ? bigint_from_double(VAL_AS_NUMBER(left)) : copy_value(left);
+            RuntimeVal r = VAL_IS_NUMBER(right) ? bigint_from_double(VAL_AS_NUMBER(right)) : copy_value(right);
+            ret = bigint_binary(l, r, op);
+            free_value(&l);
+            free_value(&r);
+        }
+        else
+        {
+            ret = eval_numeric_binary_expr((NumberVal){VAL_TO_DOUBLE(left)}, (NumberVal){VAL_TO_DOUBLE(right)}, op);
+        }
+        free_value(&left);
+        free_value(&right);
+        return ret;
     }
 
-    if (left.type == VAL_String && right.type == VAL_String)
+    if (VAL_IS_BOOL(left) && VAL_IS_BOOL(right))
     {
-        RuntimeVal ret = eval_string_binary_expr(left.data.s, right.data.s, be.op);
+        return eval_bool_binary_expr((BoolVal){VAL_AS_BOOL(left)}, (BoolVal){VAL_AS_BOOL(right)}, op);
+    }
+
+    if (VAL_IS_STRING(left) && VAL_IS_STRING(right))
+    {
+        RuntimeVal ret = eval_string_binary_expr(left, right, op);
         free_value(&left);
         free_value(&right);
         return ret;
     }
 
-    if ((left.type == VAL_Number && right.type == VAL_String) || (left.type == VAL_String && right.type == VAL_Number))
+    if ((VAL_IS_NUMERIC(left) && VAL_IS_STRING(right)) || (VAL_IS_STRING(left) && VAL_IS_NUMERIC(right)))
     {
         RuntimeVal ret;
-        if (left.type == VAL_Number)
+        if (VAL_IS_NUMERIC(left))
         {
-            ret = eval_numeric_string_binary_expr(left.data.n, right.data.s, be.op);
-            free_value(&right);
+            ret = eval_numeric_string_binary_expr((NumberVal){VAL_TO_DOUBLE(left)}, right, op);
         }
         else
         {
-            ret = eval_numeric_string_binary_expr(right.data.n, left.data.s, be.op);
-            free_value(&left);        
+            ret = eval_numeric_string_binary_expr((NumberVal){VAL_TO_DOUBLE(right)}, left, op);
         }
+        free_value(&left);
+        free_value(&right);
         return ret;
     }
 
-    if ((left.type == VAL_Bool && right.type == VAL_Number) || (left.type == VAL_Number && right.type == VAL_Bool))
+    if ((VAL_IS_BOOL(left) && VAL_IS_NUMERIC(right)) || (VAL_IS_NUMERIC(left) && VAL_IS_BOOL(right)))
     {
-        return left.type == VAL_Number ? eval_numeric_bool_expr(left.data.n,right.data.b, be.op) : eval_numeric_bool_expr(right.data.n,left.data.b, be.op);
+        RuntimeVal ret = VAL_IS_NUMERIC(left) ? eval_numeric_bool_expr((NumberVal){VAL_TO_DOUBLE(left)},(BoolVal){VAL_AS_BOOL(right)}, op) : eval_numeric_bool_expr((NumberVal){VAL_TO_DOUBLE(right)},(BoolVal){VAL_AS_BOOL(left)}, op);
+        free_value(&left);
+        free_value(&right);
+        return ret;
+    }
+
+    if ((VAL_IS_ARRAY(left) && (VAL_IS_ARRAY(right) || VAL_IS_NUMERIC(right))) || (VAL_IS_NUMERIC(left) && VAL_IS_ARRAY(right)))
+    {
+        RuntimeVal ret = array_binary(left, right, op);
+        free_value(&left);
+        free_value(&right);
+        return ret;
+    }
+
+    if (VAL_IS_MAP(left) && VAL_IS_MAP(right) && !strcmp(op, "=="))
+    {
+        bool eq = map_equals((MapObj *)VAL_AS_OBJ(left), (MapObj *)VAL_AS_OBJ(right));
+        free_value(&left);
+        free_value(&right);
+        return runtimeval_bool(eq);
     }
 
-    if (left.type != right.type && !strcmp(be.op, "=="))
+    if (VAL_IS_RECORD(left) && VAL_IS_RECORD(right) && !strcmp(op, "=="))
     {
-        if (left.type != right.type)
+        bool eq = record_equals((RecordObj *)VAL_AS_OBJ(left), (RecordObj *)VAL_AS_OBJ(right));
+        free_value(&left);
+        free_value(&right);
+        return runtimeval_bool(eq);
+    }
+
+    if (VAL_TYPE(left) != VAL_TYPE(right) && !strcmp(op, "=="))
+    {
+        free_value(&left);
+        free_value(&right);
+        return runtimeval_bool(false);
+    }
+
+    fprintf(stderr, "Invalid operation %s for operand types: \"%s\" and \"%s\"\n", op, type_name(left), type_name(right));
+    exit(EXIT_FAILURE);
+}
+
+int double_to_int64(double d, int64_t *out)
+{
+    if (floor(d) != d || d < -9223372036854775808.0 || d >= 9223372036854775808.0)
+        return 0;
+    *out = (int64_t)d;
+    return 1;
+}
+
+static RuntimeVal promote(IntegerVal left, IntegerVal right, char *op)
+{
+    // Overflowed int64_t,redo it as bigints.
+    RuntimeVal l = runtimeval_integer(left.value), r = runtimeval_integer(right.value);
+    RuntimeVal ret = bigint_binary(l, r, op);
+    free_value(&l);
+    free_value(&r);
+    return ret;
+}
+
+RuntimeVal eval_integer_binary_expr(IntegerVal left, IntegerVal right, char *op)
+{
+    int64_t res;
+    switch (op[0])
+    {
+    case '+':
+        if (!__builtin_add_overflow(left.value, right.value, &res))
+            return runtimeval_integer(res);
+        return promote(left, right, op);
+    case '-':
+        if (!__builtin_sub_overflow(left.value, right.value, &res))
+            return runtimeval_integer(res);
+        return promote(left, right, op);
+    case '*':
+        if (!__builtin_mul_overflow(left.value, right.value, &res))
+            return runtimeval_integer(res);
+        return promote(left, right, op);
+    case '/':
+        if (left.value == INT64_MIN && right.value == -1)
+            return promote(left, right, op);
+        if (right.value != 0 && left.value % right.value == 0)
+            return runtimeval_integer(left.value / right.value);
+        return runtimeval_number((double)left.value / (double)right.value); // Non-integral,or x/0 giving inf/nan as before.
+    case '%':
+        if (right.value == 0)
+        {
+            fprintf(stderr, "Modulo by zero.\n");
+            exit(EXIT_FAILURE);
+        }
+        return runtimeval_integer(right.value == -1 ? 0 : left.value % right.value);
+    case '&':
+        return runtimeval_integer(left.value & right.value);
+    case '|':
+        return runtimeval_integer(left.value | right.value);
+    case '^':
+        return runtimeval_integer(left.value ^ right.value);
+    case '=':
+        if (op[1] == '=')
+            return runtimeval_bool(left.value == right.value);
+        break;
+    case '<':
+        if (op[1] == '<')
+        {
+            if (right.value < 0)
+            {
+                fprintf(stderr, "Negative shift count.\n");
+                exit(EXIT_FAILURE);
+            }
+            if (right.value < 64 && left.value >= (INT64_MIN >> right.value) && left.value <= (INT64_MAX >> right.value))
+                return runtimeval_integer((int64_t)((uint64_t)left.value << right.value));
+            return promote(left, right, op);
+        }
+        return runtimeval_bool(op[1] == '=' ? left.value <= right.value : left.value < right.value);
+    case '>':
+        if (op[1] == '>')
         {
-            return runtimeval_bool(false);
+            if (right.value < 0)
+            {
+                fprintf(stderr, "Negative shift count.\n");
+                exit(EXIT_FAILURE);
+            }
+            return runtimeval_integer(left.value >> (right.value > 63 ? 63 : right.value));
         }
+        return runtimeval_bool(op[1] == '=' ? left.value >= right.value : left.value > right.value);
+    default:
+        break;
     }
 
-    fprintf(stderr, "Exhaustive handling of operand types in eval_binary_expr\n");
+    fprintf(stderr, "Invalid operation %s for operand types: \"integer\" and \"integer\"\n", op);
     exit(EXIT_FAILURE);
 }
 
@@ -209,6 +560,20 @@ RuntimeVal eval_numeric_binary_expr(NumberVal left, NumberVal right, char *op)
     {
         return runtimeval_number(left.value / right.value);
     }
+    else if (!strcmp(op, "%"))
+    {
+        return runtimeval_number(fmod(left.value, right.value));
+    }
+    else if (!strcmp(op, "&") || !strcmp(op, "|") || !strcmp(op, "^") || !strcmp(op, "<<") || !strcmp(op, ">>"))
+    {
+        int64_t l, r;
+        if (!double_to_int64(left.value, &l) || !double_to_int64(right.value, &r))
+        {
+            fprintf(stderr, "Cannot perform %s on non-integer value.\n", op);
+            exit(EXIT_FAILURE);
+        }
+        return eval_integer_binary_expr((IntegerVal){l}, (IntegerVal){r}, op);
+    }
     else if (!strcmp(op, "=="))
     {
         return runtimeval_bool(left.value == right.value);
@@ -234,27 +599,17 @@ RuntimeVal eval_numeric_binary_expr(NumberVal left, NumberVal right, char *op)
     exit(EXIT_FAILURE);
 }
 
-RuntimeVal eval_string_binary_expr(StringVal left, StringVal right, char *op)
+RuntimeVal eval_string_binary_expr(RuntimeVal left, RuntimeVal right, char *op)
 {
     if (!strcmp(op, "+"))
     {
-        size_t left_size = strlen(left.value);
-        size_t right_size = strlen(right.value);
-        char *buf = malloc(left_size + right_size + 1);
-        if (!buf)
-        {
-            fprintf(stderr, "Memory allocation error happened during addition of string %s and string %s", right.value, left.value);
-            exit(EXIT_FAILURE);
-        }
-        memcpy(buf, left.value, strlen(left.value));
-        memcpy(buf + strlen(left.value), right.value, strlen(right.value) + 1);
-        RuntimeVal ret = runtimeval_string(buf);
-        free(buf);
-        return ret;
+        return string_concat(left, right);
     }
     else if (!strcmp(op, "=="))
     {
-        return runtimeval_bool(!strcmp(left.value,right.value));
+        if (VAL_STRING_LENGTH(left) != VAL_STRING_LENGTH(right))
+            return runtimeval_bool(false); // Without flattening either side.
+        return runtimeval_bool(string_equals(VAL_AS_STRING(&left), VAL_AS_STRING(&right)));
     }
 
     fprintf(stderr, "Invalid operand operation %s for operand types \"string\" and \"string\"\n", op);
@@ -276,42 +631,27 @@ RuntimeVal eval_bool_binary_expr(BoolVal left, BoolVal right, char *op)
     exit(EXIT_FAILURE);
 }
 
-RuntimeVal eval_numeric_string_binary_expr(NumberVal left, StringVal right, char *op)
+RuntimeVal eval_numeric_string_binary_expr(NumberVal left, RuntimeVal right, char *op)
 {
     if (!strcmp(op, "*"))
     {
-        if (left.value != (int)left.value)
+        // floor instead of an (int) cast,which is undefined past INT_MAX and ropes make such counts cheap.
+        if (floor(left.value) != left.value)
         {
             fprintf(stderr, "Cannot multiply string with non-integer.");
             exit(EXIT_FAILURE);
         }
-
-        // size_t i = 0;
-        size_t len = strlen(right.value);
-        size_t total = left.value * len;
-        char *buf = malloc(total + 1);
-
-        if (!buf)
+        if (left.value < 0)
         {
-            fprintf(stderr, "Memory allocation error happened during multiplication of string %s and int %.0f", right.value, left.value);
+            fprintf(stderr, "Cannot multiply string with negative number.");
             exit(EXIT_FAILURE);
         }
-
-        // Copy first instance
-        memcpy(buf, right.value, len);
-        size_t copied = len;
-
-        while (copied < total)
+        if (left.value >= (double)SIZE_MAX) // SIZE_MAX rounds up to a power of 2,which doesn't fit.
         {
-            size_t to_copy = (copied > total - copied) ? total - copied : copied;
-            memcpy(buf + copied, buf, to_copy);
-            copied += to_copy;
+            fprintf(stderr, "String repetition by %g is too long.\n", left.value);
+            exit(EXIT_FAILURE);
         }
-
-        buf[total] = '\0';
-        RuntimeVal ret = runtimeval_string(buf);
-        free(buf);
-        return ret;
+        return string_repeat(right, (size_t)left.value);
     }
 
     fprintf(stderr, "Invalid operation %s for operand types: \"number\" and \"string\"\n", op);
@@ -345,12 +685,433 @@ RuntimeVal eval_numeric_bool_expr(NumberVal left, BoolVal right, char *op)
     exit(EXIT_FAILURE);
 }
 
+// `s = s + x` and `s += x` append into s's own buffer when the binding is the only reference to it,
+// growing it geometrically,so building a string in a loop is amortized linear and stays contiguous.
+static int append_in_place(AssignmentExpr a, Scope *scope, RuntimeVal *out)
+{
+    Identifier *var = &a.assigne->data.i;
+    char *name = var->symbol;
+    Expr *piece = a.value;
+    if (a.op ? strcmp(a.op, "+") != 0 : (piece->kind != EXPR_BinaryExpr || strcmp(piece->data.be.op, "+") || piece->data.be.left->kind != EXPR_Identifier || strcmp(piece->data.be.left->data.i.symbol, name)))
+        return 0;
+    if (!a.op)
+        piece = piece->data.be.right;
+
+    size_t idx;
+    Scope *s = locate_write(scope, var, &idx);
+    // Cells and constants go through setvar.piece runs before s is read,so it must not assign.
+    if ((s->cells && s->cells[idx]) || s->isconst[idx] || !VAL_IS_HEAP_STRING(s->values[idx]) || !expr_is_pure(piece))
+        return 0;
+
+    RuntimeVal right = eval_expr(piece, scope);
+    RuntimeVal *slot = &s->values[idx];
+    Obj *target = VAL_IS_HEAP_STRING(*slot) ? VAL_AS_OBJ(*slot) : NULL;
+    if (!VAL_IS_STRING(right) || !target || target->kind != OBJ_String || __atomic_load_n(&target->refcount, __ATOMIC_ACQUIRE) != 1)
+    {
+        *out = setvar_id(scope, var, eval_binary_values(getvar_id(scope, var), right, "+"));
+        return 1;
+    }
+    StringVal add = VAL_AS_STRING(&right);
+    StringObj *str = (StringObj *)target;
+    if (str->length > SIZE_MAX - add.length)
+    {
+        fprintf(stderr, "String concatenation of lengths %zu and %zu is too long.\n", str->length, add.length);
+        exit(EXIT_FAILURE);
+    }
+    str = string_reserve(str, str->length + add.length);
+    memcpy(str->chars + str->length, add.chars, add.length);
+    str->length += add.length;
+    str->chars[str->length] = '\0';
+    str->hash = 0;
+    *slot = runtimeval_string_obj(str);
+    free_value(&right);
+    *out = copy_value(*slot);
+    return 1;
+}
+
+static bool obj_is(RuntimeVal val, ObjType kind)
+{
+    return VAL_IS_OBJ(val) && VAL_AS_OBJ(val)->kind == kind;
+}
+
+static Obj *obj_copy(Obj *obj)
+{
+    if (obj->kind == OBJ_Map)
+        return &map_copy((MapObj *)obj)->obj;
+    return &record_copy((RecordObj *)obj)->obj;
+}
+
+Obj *obj_for_update(Scope *scope, Identifier *var, ObjType kind, RuntimeVal *fresh)
+{
+    size_t idx;
+    *fresh = runtimeval_null();
+    Scope *s = locate_write(scope, var, &idx);
+    RuntimeVal current = s->values[idx];
+    if (!obj_is(current, kind) || (s->cells && s->cells[idx]))
+    {
+        // Cells refresh on read,so get the value the normal way.
+        RuntimeVal val = getvar_id(scope, var);
+        if (!obj_is(val, kind))
+        {
+            fprintf(stderr, "%s is not a %s.\n", var->symbol, kind == OBJ_Map ? "map" : "record");
+            exit(EXIT_FAILURE);
+        }
+        *fresh = runtimeval_obj(obj_copy(VAL_AS_OBJ(val)));
+        free_value(&val);
+        return VAL_AS_OBJ(*fresh);
+    }
+    Obj *obj = VAL_AS_OBJ(current);
+    if (__atomic_load_n(&obj->refcount, __ATOMIC_ACQUIRE) == 1 && !s->isconst[idx])
+        return obj;
+    *fresh = runtimeval_obj(obj_copy(obj)); // Shared:whoever else holds it keeps the old one.
+    return VAL_AS_OBJ(*fresh);
+}
+
+// m[k] = v and m[k] op= v.The target,then the key,then the value are evaluated.
+static RuntimeVal assign_entry(AssignmentExpr a, Scope *scope)
+{
+    IndexExpr idx = a.assigne->data.idx;
+    if (idx.target->kind != EXPR_Identifier)
+    {
+        fprintf(stderr, "Can only assign to an entry of a map variable.\n");
+        exit(EXIT_FAILURE);
+    }
+    Identifier *var = &idx.target->data.i;
+    RuntimeVal target = getvar_id(scope, var);
+    if (!VAL_IS_MAP(target))
+    {
+        fprintf(stderr, "Can only assign to an entry of a map variable.\n");
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal key = eval_expr(idx.index, scope);
+    RuntimeVal value;
+    if (a.op)
+    {
+        RuntimeVal *old = map_find((MapObj *)VAL_AS_OBJ(target), key);
+        if (!old)
+        {
+            fprintf(stderr, "Key not found in map.\n");
+            exit(EXIT_FAILURE);
+        }
+        RuntimeVal left = copy_value(*old);
+        value = eval_binary_values(left, eval_expr(a.value, scope), a.op);
+    }
+    else
+    {
+        value = eval_expr(a.value, scope);
+    }
+    free_value(&target); // Dropped before obj_for_update looks at the refcount.
+
+    RuntimeVal fresh;
+    MapObj *map = (MapObj *)obj_for_update(scope, var, OBJ_Map, &fresh);
+    RuntimeVal ret = copy_value(value);
+    map_set(map, key, value);
+    free_value(&key);
+    if (!VAL_IS_NULL(fresh))
+    {
+        RuntimeVal stored = setvar_id(scope, var, fresh);
+        free_value(&stored);
+    }
+    return ret;
+}
+
+// r.f = v and r.f op= v,the same way as assign_entry.A missing field is added to the record.
+static RuntimeVal assign_field(AssignmentExpr a, Scope *scope)
+{
+    MemberExpr *mem = &a.assigne->data.mem;
+    if (mem->object->kind != EXPR_Identifier)
+    {
+        fprintf(stderr, "Can only assign to a field of a record variable.\n");
+        exit(EXIT_FAILURE);
+    }
+    Identifier *var = &mem->object->data.i;
+    RuntimeVal target = getvar_id(scope, var);
+    if (!VAL_IS_RECORD(target))
+    {
+        fprintf(stderr, "Can only assign to a field of a record variable.\n");
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal value;
+    if (a.op)
+    {
+        RuntimeVal *old = record_field((RecordObj *)VAL_AS_OBJ(target), mem->property, mem->cache);
+        if (!old)
+        {
+            fprintf(stderr, "Record has no field %s.\n", mem->property);
+            exit(EXIT_FAILURE);
+        }
+        RuntimeVal left = copy_value(*old);
+        value = eval_binary_values(left, eval_expr(a.value, scope), a.op);
+    }
+    else
+    {
+        value = eval_expr(a.value, scope);
+    }
+    free_value(&target);
+
+    RuntimeVal fresh;
+    RecordObj *rec = (RecordObj *)obj_for_update(scope, var, OBJ_Record, &fresh);
+    RuntimeVal ret = copy_value(value);
+    record_set(rec, mem->property, value, mem->cache);
+    if (!VAL_IS_NULL(fresh))
+    {
+        RuntimeVal stored = setvar_id(scope, var, fresh);
+        free_value(&stored);
+    }
+    return ret;
+}
+
 RuntimeVal eval_assignment_expr(AssignmentExpr a, Scope *scope)
 {
+    if (a.assigne->kind == EXPR_IndexExpr)
+        return assign_entry(a, scope);
+    if (a.assigne->kind == EXPR_MemberExpr)
+        return assign_field(a, scope);
     if (a.assigne->kind != EXPR_Identifier)
     {
         fprintf(stderr, "Cannot assign value to non-identifier.\n");
         exit(EXIT_FAILURE);
     }
-    return setvar(scope, a.assigne->data.i.symbol, eval_expr(a.value, scope));
-}
\ No newline at end of file
+    RuntimeVal ret;
+    if (append_in_place(a, scope, &ret))
+        return ret;
+    if (!a.op)
+        return setvar_id(scope, &a.assigne->data.i, eval_expr(a.value, scope));
+    RuntimeVal left = getvar_id(scope, &a.assigne->data.i); // x op= y reads x once,before y.
+    RuntimeVal right = eval_expr(a.value, scope);
+    return setvar_id(scope, &a.assigne->data.i, eval_binary_values(left, right, a.op));
+}
+
+RuntimeVal eval_array_literal(ArrayLiteral arr, Scope *scope)
+{
+    ArrayObj *out = array_alloc(arr.len);
+    for (size_t i = 0; i < arr.len; i++)
+    {
+        RuntimeVal elem = eval_expr(arr.elements[i], scope);
+        if (!VAL_IS_NUMERIC(elem))
+        {
+            fprintf(stderr, "Array elements must be numbers.\n");
+            exit(EXIT_FAILURE);
+        }
+        out->data[i] = VAL_TO_DOUBLE(elem);
+        free_value(&elem);
+    }
+    return runtimeval_array(out);
+}
+
+RuntimeVal eval_map_literal(MapLiteral lit, Scope *scope)
+{
+    MapObj *map = map_alloc(lit.len);
+    for (size_t i = 0; i < lit.len; i++)
+    {
+        RuntimeVal key = eval_expr(lit.keys[i], scope);
+        map_set(map, key, eval_expr(lit.values[i], scope)); // A repeated key keeps its last value.
+        free_value(&key);
+    }
+    return runtimeval_map(map);
+}
+
+// What a hole renders as.Strings are viewed where they are and a bigint is swapped for its decimal
+// string in *val,so the view lives as long as *val does.Numbers are only measured here(chars is NULL)
+// and formatted by write_hole straight into the result.
+static StringVal hole_text(RuntimeVal *val)
+{
+    StringVal text;
+    text.chars = NULL;
+    text.obj = NULL;
+    switch (VAL_TYPE(*val))
+    {
+    case VAL_String:
+        return VAL_AS_STRING(val);
+    case VAL_Number:
+        text.length = format_number(VAL_AS_NUMBER(*val), NULL, 0);
+        return text;
+    case VAL_Integer:
+        if (VAL_IS_BIGINT(*val))
+        {
+            ScratchMark mark = scratch_mark();
+            RuntimeVal str = runtimeval_string(bigint_to_decimal((BigIntObj *)VAL_AS_OBJ(*val)));
+            scratch_release(mark);
+            free_value(val);
+            *val = str;
+            return VAL_AS_STRING(val);
+        }
+        {
+            char buf[FORMAT_INTEGER_MAX + 1];
+            text.length = format_integer(VAL_AS_INTEGER(*val), buf);
+        }
+        return text;
+    case VAL_Bool:
+        text.chars = VAL_AS_BOOL(*val) ? "true" : "false";
+        text.length = strlen(text.chars);
+        return text;
+    case VAL_Null:
+        text.chars = "null";
+        text.length = 4;
+        return text;
+    default:
+        fprintf(stderr, "Only strings, numbers, booleans and null can be put in a string template.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Writes the text of a hole at dst,which has room for a '\0' after it.
+static void write_hole(char *dst, RuntimeVal val, StringVal text)
+{
+    if (text.chars)
+        memcpy(dst, text.chars, text.length);
+    else if (VAL_IS_NUMBER(val))
+        format_number(VAL_AS_NUMBER(val), dst, text.length + 1);
+    else
+        format_integer(VAL_AS_INTEGER(val), dst);
+}
+
+RuntimeVal eval_template_literal(TemplateLiteral tpl, Scope *scope)
+{
+    // Every hole is evaluated and measured first,then the whole thing is written into one exactly sized string.
+    size_t n = tpl.nholes ? tpl.nholes : 1;
+    RuntimeVal vals[n];
+    StringVal texts[n];
+    size_t total = tpl.literal_length;
+    for (size_t i = 0; i < tpl.nholes; i++)
+    {
+        vals[i] = eval_expr(tpl.holes[i], scope);
+        texts[i] = hole_text(&vals[i]);
+        if (texts[i].length > SIZE_MAX - 1 - total)
+        {
+            fprintf(stderr, "String template result is too long.\n");
+            exit(EXIT_FAILURE);
+        }
+        total += texts[i].length;
+    }
+
+    char small[VAL_SHORT_STRING_MAX + 1]; // Formatting a number writes a '\0' after it.
+    StringObj *out = total <= VAL_SHORT_STRING_MAX ? NULL : string_alloc(total);
+    char *dst = out ? out->chars : small;
+    for (size_t i = 0; i < tpl.nholes; i++)
+    {
+        memcpy(dst, tpl.parts[i], tpl.partlens[i]);
+        dst += tpl.partlens[i];
+        write_hole(dst, vals[i], texts[i]);
+        dst += texts[i].length;
+    }
+    memcpy(dst, tpl.parts[tpl.nholes], tpl.partlens[tpl.nholes]);
+    for (size_t i = 0; i < tpl.nholes; i++)
+        free_value(&vals[i]);
+    return out ? runtimeval_string_obj(out) : runtimeval_string_len(small, total);
+}
+
+RuntimeVal eval_record_literal(RecordLiteral *lit, Scope *scope)
+{
+    // Every record a literal builds has the same fields in the same order,so its shape is looked up once.
+    Shape *shape = __atomic_load_n((Shape **)&lit->shape, __ATOMIC_ACQUIRE);
+    if (!shape)
+    {
+        shape = shape_root();
+        for (size_t i = 0; i < lit->len; i++)
+            shape = shape_with(shape, lit->names[i]);
+        __atomic_store_n((Shape **)&lit->shape, shape, __ATOMIC_RELEASE); // A racing thread stores the same one.
+    }
+    RecordObj *rec = record_alloc(shape);
+    for (size_t i = 0; i < lit->len; i++)
+        rec->slots[i] = eval_expr(lit->values[i], scope);
+    return runtimeval_record(rec);
+}
+
+RuntimeVal eval_member_expr(MemberExpr *mem, Scope *scope)
+{
+    RuntimeVal object = eval_expr(mem->object, scope);
+    if (!VAL_IS_RECORD(object))
+    {
+        fprintf(stderr, "Only records have fields.\n");
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal *field = record_field((RecordObj *)VAL_AS_OBJ(object), mem->property, mem->cache);
+    if (!field)
+    {
+        fprintf(stderr, "Record has no field %s.\n", mem->property);
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal ret = copy_value(*field);
+    free_value(&object);
+    return ret;
+}
+
+RuntimeVal eval_index_expr(IndexExpr idx, Scope *scope)
+{
+    RuntimeVal target = eval_expr(idx.target, scope);
+    RuntimeVal index = eval_expr(idx.index, scope);
+    if (VAL_IS_MAP(target))
+    {
+        RuntimeVal *found = map_find((MapObj *)VAL_AS_OBJ(target), index);
+        if (!found)
+        {
+            fprintf(stderr, "Key not found in map.\n");
+            exit(EXIT_FAILURE);
+        }
+        RuntimeVal ret = copy_value(*found);
+        free_value(&target);
+        free_value(&index);
+        return ret;
+    }
+    if (!VAL_IS_ARRAY(target))
+    {
+        fprintf(stderr, "Only arrays and maps can be indexed.\n");
+        exit(EXIT_FAILURE);
+    }
+    int64_t i;
+    if (VAL_IS_INTEGER(index))
+        i = VAL_AS_INTEGER(index);
+    else if (!VAL_IS_NUMBER(index) || !double_to_int64(VAL_AS_NUMBER(index), &i))
+    {
+        fprintf(stderr, "Array index must be an integer.\n");
+        exit(EXIT_FAILURE);
+    }
+    ArrayObj *arr = (ArrayObj *)VAL_AS_OBJ(target);
+    if (i < 0 || (uint64_t)i >= arr->length)
+    {
+        fprintf(stderr, "Array index %" PRId64 " out of bounds for length %zu.\n", i, arr->length);
+        exit(EXIT_FAILURE);
+    }
+    RuntimeVal ret = runtimeval_number(arr->data[i]);
+    free_value(&target);
+    free_value(&index);
+    return ret;
+}
+
+RuntimeVal eval_call_expr(CallExpr *call, Scope *scope)
+{
+    const Builtin *builtin = __atomic_load_n((const Builtin **)&call->builtin, __ATOMIC_ACQUIRE);
+    if (!builtin)
+    {
+        builtin = find_builtin(call->callee);
+        if (!builtin)
+        {
+            fprintf(stderr, "Unknown function %s.\n", call->callee);
+            exit(EXIT_FAILURE);
+        }
+        if (call->argc != builtin->arity)
+        {
+            fprintf(stderr, "%s takes %zu argument(s) but got %zu.\n", builtin->name, builtin->arity, call->argc);
+            exit(EXIT_FAILURE);
+        }
+        __atomic_store_n((const Builtin **)&call->builtin, builtin, __ATOMIC_RELEASE); // A racing thread stores the same one.
+    }
+    // Math builtins take their arguments directly,no array of them and no fn in between.
+    if (builtin->unary)
+        return math_call1(builtin, eval_expr(call->args[0], scope));
+    if (builtin->binary)
+    {
+        RuntimeVal left = eval_expr(call->args[0], scope);
+        return math_call2(builtin, left, eval_expr(call->args[1], scope));
+    }
+    if (builtin->form)
+        return builtin->form(call->args, call->argc, scope);
+    RuntimeVal args[call->argc ? call->argc : 1];
+    for (size_t i = 0; i < call->argc; i++)
+        args[i] = eval_expr(call->args[i], scope);
+    RuntimeVal ret = builtin->fn(args, call->argc);
+    for (size_t i = 0; i < call->argc; i++)
+        free_value(&args[i]);
+    return ret;
+}
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "runtime/values.h"
+#include "runtime/map.h"
+#include "runtime/slab.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t h2) // Bit i set when ctrl[i] == h2.
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline uint32_t group_empty(const uint8_t *ctrl) // MAP_EMPTY is the only control byte with the top bit set.
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t h2)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < MAP_GROUP_WIDTH; i++)
+        bits |= (uint32_t)(ctrl[i] == h2) << i;
+    return bits;
+}
+
+static inline uint32_t group_empty(const uint8_t *ctrl)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < MAP_GROUP_WIDTH; i++)
+        bits |= (uint32_t)(ctrl[i] == MAP_EMPTY) << i;
+    return bits;
+}
+#endif
+
+static uint64_t mix(uint64_t h) // Spreads every input bit over both the probe position and the control byte.
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// A new reference to the key as it is stored,or an error for keys that can't be hashed.
+static RuntimeVal normalize_key(RuntimeVal key)
+{
+    if (VAL_IS_NUMBER(key))
+    {
+        double d = VAL_AS_NUMBER(key);
+        if (floor(d) == d && d >= -9223372036854775808.0 && d < 9223372036854775808.0)
+            return runtimeval_integer((int64_t)d); // Also folds -0 into 0.
+        return key;
+    }
+    if (VAL_IS_STRING(key) || VAL_IS_INTEGER(key) || VAL_IS_BOOL(key))
+        return copy_value(key);
+    fprintf(stderr, "Map keys must be strings, numbers that fit 64 bits or booleans.\n");
+    exit(EXIT_FAILURE);
+}
+
+static uint64_t hash_key(RuntimeVal key) // key is normalized.
+{
+    if (VAL_IS_STRING(key))
+    {
+        StringVal view = VAL_AS_STRING(&key);
+        if (view.obj)
+            return mix(string_hash(view.obj)); // Cached after the first time.
+        uint64_t h = 14695981039346656037ULL; // Same FNV-1a as string_hash,so it doesn't matter where the chars live.
+        for (size_t i = 0; i < view.length; i++)
+        {
+            h ^= (unsigned char)view.chars[i];
+            h *= 1099511628211ULL;
+        }
+        return mix(h ? h : 1);
+    }
+    if (VAL_IS_INTEGER(key))
+        return mix((uint64_t)VAL_AS_INTEGER(key));
+    return mix(key.bits);
+}
+
+static bool key_equals(RuntimeVal a, RuntimeVal b) // Both normalized.
+{
+    if (VAL_IS_STRING(a) && VAL_IS_STRING(b))
+        return string_equals(VAL_AS_STRING(&a), VAL_AS_STRING(&b));
+    if (VAL_IS_INTEGER(a) && VAL_IS_INTEGER(b))
+        return VAL_AS_INTEGER(a) == VAL_AS_INTEGER(b);
+    return a.bits == b.bits;
+}
+
+static void set_ctrl(MapObj *map, size_t i, uint8_t ctrl)
+{
+    map->ctrl[i] = ctrl;
+    if (i < MAP_GROUP_WIDTH)
+        map->ctrl[map->capacity + i] = ctrl; // The mirror a group starting near the end reads.
+}
+
+static void init_table(MapObj *map, size_t capacity)
+{
+    map->capacity = capacity;
+    map->ctrl = malloc(capacity + MAP_GROUP_WIDTH);
+    map->slots = malloc(sizeof(MapSlot) * capacity);
+    if (!map->ctrl || !map->slots)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating map of %zu slots.\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+    memset(map->ctrl, MAP_EMPTY, capacity + MAP_GROUP_WIDTH);
+}
+
+MapObj *map_alloc(size_t length)
+{
+    MapObj *map = slab_alloc(sizeof(MapObj));
+    if (!map)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating map.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t capacity = MAP_MIN_CAPACITY;
+    while (capacity / MAP_MAX_LOAD_DEN * MAP_MAX_LOAD_NUM < length)
+        capacity *= 2;
+    map->obj.refcount = 1;
+    map->obj.kind = OBJ_Map;
+    map->length = 0;
+    init_table(map, capacity);
+    return map;
+}
+
+RuntimeVal runtimeval_map(MapObj *map)
+{
+    return runtimeval_obj(&map->obj);
+}
+
+MapObj *map_copy(const MapObj *map)
+{
+    MapObj *ret = map_alloc(0);
+    free(ret->ctrl);
+    free(ret->slots);
+    init_table(ret, map->capacity);
+    memcpy(ret->ctrl, map->ctrl, map->capacity + MAP_GROUP_WIDTH);
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->ctrl[i] == MAP_EMPTY)
+            continue;
+        ret->slots[i].key = copy_value(map->slots[i].key);
+        ret->slots[i].value = copy_value(map->slots[i].value);
+    }
+    ret->length = map->length;
+    return ret;
+}
+
+static size_t find_index(const MapObj *map, RuntimeVal key, uint64_t hash) // map->capacity when missing.
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = (hash >> 7) & mask;
+    uint8_t h2 = hash & 0x7F;
+    for (;;)
+    {
+        for (uint32_t match = group_match(map->ctrl + pos, h2); match; match &= match - 1)
+        {
+            size_t i = (pos + (size_t)__builtin_ctz(match)) & mask;
+            if (key_equals(map->slots[i].key, key))
+                return i;
+        }
+        // Entries sit in the first free slot from their home on and nothing is ever left behind,
+        // so an empty slot in this group means the key would have been found by now.
+        if (group_empty(map->ctrl + pos))
+            return map->capacity;
+        pos = (pos + MAP_GROUP_WIDTH) & mask;
+    }
+}
+
+static size_t find_empty(const MapObj *map, uint64_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = (hash >> 7) & mask;
+    for (;;)
+    {
+        uint32_t empty = group_empty(map->ctrl + pos);
+        if (empty)
+            return (pos + (size_t)__builtin_ctz(empty)) & mask;
+        pos = (pos + MAP_GROUP_WIDTH) & mask;
+    }
+}
+
+static void grow(MapObj *map)
+{
+    uint8_t *ctrl = map->ctrl;
+    MapSlot *slots = map->slots;
+    size_t capacity = map->capacity;
+    init_table(map, capacity * 2);
+    for (size_t i = 0; i < capacity; i++)
+    {
+        if (ctrl[i] == MAP_EMPTY)
+            continue;
+        uint64_t hash = hash_key(slots[i].key);
+        size_t j = find_empty(map, hash);
+        set_ctrl(map, j, hash & 0x7F);
+        map->slots[j] = slots[i];
+    }
+    free(ctrl);
+    free(slots);
+}
+
+RuntimeVal *map_find(const MapObj *map, RuntimeVal key)
+{
+    RuntimeVal k = normalize_key(key);
+    size_t i = find_index(map, k, hash_key(k));
+    free_value(&k);
+    return i == map->capacity ? NULL : &map->slots[i].value;
+}
+
+void map_set(MapObj *map, RuntimeVal key, RuntimeVal value)
+{
+    RuntimeVal k = normalize_key(key);
+    uint64_t hash = hash_key(k);
+    size_t i = find_index(map, k, hash);
+    if (i != map->capacity)
+    {
+        free_value(&map->slots[i].value);
+        map->slots[i].value = value;
+        free_value(&k);
+        return;
+    }
+    if ((map->length + 1) * MAP_MAX_LOAD_DEN > map->capacity * MAP_MAX_LOAD_NUM)
+        grow(map);
+    i = find_empty(map, hash);
+    set_ctrl(map, i, hash & 0x7F);
+    map->slots[i].key = k;
+    map->slots[i].value = value;
+    map->length++;
+}
+
+bool map_delete(MapObj *map, RuntimeVal key)
+{
+    RuntimeVal k = normalize_key(key);
+    size_t hole = find_index(map, k, hash_key(k));
+    free_value(&k);
+    if (hole == map->capacity)
+        return false;
+    free_value(&map->slots[hole].key);
+    free_value(&map->slots[hole].value);
+    set_ctrl(map, hole, MAP_EMPTY);
+    map->length--;
+
+    // Backward shift:pull every later entry of the cluster that may move into the hole,so no probe
+    // that used to pass through it stops early.
+    size_t mask = map->capacity - 1;
+    for (size_t j = (hole + 1) & mask; map->ctrl[j] != MAP_EMPTY; j = (j + 1) & mask)
+    {
+        size_t home = (hash_key(map->slots[j].key) >> 7) & mask;
+        if (((j - home) & mask) < ((j - hole) & mask))
+            continue; // Its home lies between the hole and j.
+        map->slots[hole] = map->slots[j];
+        set_ctrl(map, hole, map->ctrl[j]);
+        set_ctrl(map, j, MAP_EMPTY);
+        hole = j;
+    }
+    return true;
+}
+
+void dump_map(const MapObj *map)
+{
+    printf("{");
+    int first = 1;
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->ctrl[i] == MAP_EMPTY)
+            continue;
+        printf(first ? "" : ", ");
+        first = 0;
+        print_nested_value(map->slots[i].key);
+        printf(": ");
+        print_nested_value(map->slots[i].value);
+    }
+    printf("}");
+}
+
+void free_map(MapObj *map)
+{
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->ctrl[i] == MAP_EMPTY)
+            continue;
+        free_value(&map->slots[i].key);
+        free_value(&map->slots[i].value);
+    }
+    free(map->ctrl);
+    free(map->slots);
+    slab_free(map);
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "runtime/values.h"
+#include "runtime/array.h"
+#include "runtime/builtins.h"
+#include "runtime/mathlib.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128d (*VecFn)(__m128d);
+
+#define TWO52 4503599627370496.0
+#define LOG2E 1.44269504088896338700e+00
+#define LN2_HI 6.93147180369123816490e-01 // ln 2 in two parts,k * LN2_HI is exact for every exponent k.
+#define LN2_LO 1.90821492927058770002e-10
+#define TWO_OVER_PI 6.36619772367581382433e-01
+#define PIO2_1 1.57079632673412561417e+00 // pi/2 in three 33 bit parts and the rest,for the argument reduction of sin/cos.
+#define PIO2_2 6.07710050630396597660e-11
+#define PIO2_3 2.02226624871116645580e-21
+#define PIO2_3T 8.47842766036889956997e-32
+
+static inline __m128d abs_pd(__m128d x)
+{
+    return _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+}
+
+static inline __m128d select_pd(__m128d mask, __m128d a, __m128d b) // a where mask is set,b elsewhere.
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+static inline __m128d horner(__m128d x, const double *c, int n) // c[0] + x*(c[1] + x*(... c[n-1])).
+{
+    __m128d acc = _mm_set1_pd(c[n - 1]);
+    for (int i = n - 2; i >= 0; i--)
+        acc = _mm_add_pd(_mm_mul_pd(acc, x), _mm_set1_pd(c[i]));
+    return acc;
+}
+
+// No SSE4.1 round instructions:adding and taking away 2^52 rounds |x| to an integer,which is then pulled down.
+static __m128d trunc_pd(__m128d x)
+{
+    __m128d ax = abs_pd(x);
+    __m128d r = _mm_sub_pd(_mm_add_pd(ax, _mm_set1_pd(TWO52)), _mm_set1_pd(TWO52));
+    r = _mm_sub_pd(r, _mm_and_pd(_mm_cmpgt_pd(r, ax), _mm_set1_pd(1.0)));
+    r = _mm_or_pd(r, _mm_and_pd(x, _mm_set1_pd(-0.0))); // The sign back,-0.5 gives -0 like trunc() does.
+    return select_pd(_mm_cmpnlt_pd(ax, _mm_set1_pd(TWO52)), x, r); // Already integral,inf or NaN.
+}
+
+static __m128d floor_pd(__m128d x)
+{
+    __m128d t = trunc_pd(x);
+    return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, x), _mm_set1_pd(1.0)));
+}
+
+static __m128d ceil_pd(__m128d x)
+{
+    __m128d t = trunc_pd(x);
+    t = _mm_add_pd(t, _mm_and_pd(_mm_cmplt_pd(t, x), _mm_set1_pd(1.0)));
+    return _mm_or_pd(t, _mm_and_pd(x, _mm_set1_pd(-0.0))); // Adding +0 would lose the sign of ceil(-0.5) = -0.
+}
+
+static __m128d round_pd(__m128d x) // Halves away from zero,like round().
+{
+    __m128d ax = abs_pd(x);
+    __m128d t = trunc_pd(ax);
+    __m128d r = _mm_add_pd(t, _mm_and_pd(_mm_cmpge_pd(_mm_sub_pd(ax, t), _mm_set1_pd(0.5)), _mm_set1_pd(1.0)));
+    r = _mm_or_pd(r, _mm_and_pd(x, _mm_set1_pd(-0.0)));
+    return select_pd(_mm_cmpnlt_pd(ax, _mm_set1_pd(TWO52)), x, r);
+}
+
+static __m128d sqrt_pd(__m128d x)
+{
+    return _mm_sqrt_pd(x);
+}
+
+// e^x = 2^k * e^r with |r| <= ln2/2.The Taylor series up to r^13 leaves less than half an ulp.
+static __m128d exp_pd(__m128d x) // x in [-708,709],so 2^k is a normal double.
+{
+    static const double c[] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+                               1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800.0};
+    __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(LOG2E))); // Rounds to nearest.
+    __m128d kd = _mm_cvtepi32_pd(k);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(kd, _mm_set1_pd(LN2_HI))), _mm_mul_pd(kd, _mm_set1_pd(LN2_LO)));
+    __m128d p = horner(r, c, sizeof c / sizeof c[0]);
+    __m128i biased = _mm_add_epi32(k, _mm_set1_epi32(1023));
+    __m128i scale = _mm_slli_epi64(_mm_unpacklo_epi32(biased, _mm_setzero_si128()), 52);
+    return _mm_mul_pd(p, _mm_castsi128_pd(scale));
+}
+
+// log x = k ln2 + log(1+f) with 1+f in [sqrt(2)/2,sqrt(2)),log(1+f) the way fdlibm does it.
+static __m128d log_pd(__m128d x) // x positive,finite and normal.
+{
+    static const double lg[] = {6.666666666666735130e-01, 3.999999999940941908e-01, 2.857142874366239149e-01,
+                                2.222219843214978396e-01, 1.818357216161805012e-01, 1.531383769920937332e-01,
+                                1.479819860511658591e-01};
+    __m128i bits = _mm_castpd_si128(x);
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm_set1_epi64x(0x3FF0000000000000LL)));
+    // The biased exponent as the low bits of 2^52,so a subtraction turns it into a double.
+    __m128d k = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), _mm_castpd_si128(_mm_set1_pd(TWO52))));
+    k = _mm_sub_pd(k, _mm_set1_pd(TWO52 + 1023));
+    __m128d high = _mm_cmpge_pd(m, _mm_set1_pd(1.41421356237309504880));
+    m = select_pd(high, _mm_mul_pd(m, _mm_set1_pd(0.5)), m);
+    k = _mm_add_pd(k, _mm_and_pd(high, _mm_set1_pd(1.0)));
+
+    __m128d f = _mm_sub_pd(m, _mm_set1_pd(1.0));
+    __m128d s = _mm_div_pd(f, _mm_add_pd(_mm_set1_pd(2.0), f));
+    __m128d z = _mm_mul_pd(s, s);
+    __m128d r = _mm_mul_pd(z, horner(z, lg, sizeof lg / sizeof lg[0]));
+    __m128d hfsq = _mm_mul_pd(_mm_set1_pd(0.5), _mm_mul_pd(f, f));
+    // k*LN2_HI - ((hfsq - (s*(hfsq+r) + k*LN2_LO)) - f)
+    __m128d inner = _mm_add_pd(_mm_mul_pd(s, _mm_add_pd(hfsq, r)), _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+    return _mm_sub_pd(_mm_mul_pd(k, _mm_set1_pd(LN2_HI)), _mm_sub_pd(_mm_sub_pd(hfsq, inner), f));
+}
+
+static inline __m128d two_sum(__m128d a, __m128d b, __m128d *err) // a + b,and in *err what rounding it lost.
+{
+    __m128d s = _mm_add_pd(a, b);
+    __m128d bb = _mm_sub_pd(s, a);
+    *err = _mm_add_pd(_mm_sub_pd(a, _mm_sub_pd(s, bb)), _mm_sub_pd(b, bb));
+    return s;
+}
+
+// x = k pi/2 + r with |r| <= pi/4,then the fdlibm kernels on r,picked and negated by the quadrant k mod 4.
+// Near a zero of sin or cos most of x cancels,so r is kept in two parts until every part of pi/2 is taken off.
+static __m128d sincos_pd(__m128d x, int cosine) // |x| <= SINCOS_MAX.
+{
+    static const double sc[] = {-1.66666666666666324348e-01, 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+                                2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10};
+    static const double cc[] = {4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+                                -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11};
+    __m128i k = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(TWO_OVER_PI)));
+    __m128d kd = _mm_cvtepi32_pd(k);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(kd, _mm_set1_pd(PIO2_1))); // Exact,k * PIO2_1 fits a double.
+    __m128d lo, err;
+    r = two_sum(r, _mm_mul_pd(kd, _mm_set1_pd(-PIO2_2)), &lo);
+    r = two_sum(r, _mm_mul_pd(kd, _mm_set1_pd(-PIO2_3)), &err);
+    lo = _mm_sub_pd(_mm_add_pd(lo, err), _mm_mul_pd(kd, _mm_set1_pd(PIO2_3T)));
+    r = _mm_add_pd(r, lo);
+    __m128d z = _mm_mul_pd(r, r);
+
+    __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(z, r), horner(z, sc, sizeof sc / sizeof sc[0])));
+    s = select_pd(_mm_cmpeq_pd(x, _mm_setzero_pd()), x, s); // r + lo already turned -0 into +0,sin(-0) is -0.
+    __m128d hz = _mm_mul_pd(_mm_set1_pd(0.5), z);
+    __m128d w = _mm_sub_pd(_mm_set1_pd(1.0), hz);
+    __m128d tail = _mm_mul_pd(_mm_mul_pd(z, z), horner(z, cc, sizeof cc / sizeof cc[0]));
+    __m128d c = _mm_add_pd(w, _mm_add_pd(_mm_sub_pd(_mm_sub_pd(_mm_set1_pd(1.0), w), hz), tail));
+
+    __m128i q = _mm_add_epi32(k, _mm_set1_epi32(cosine)); // cos x is sin(x + pi/2).
+    q = _mm_unpacklo_epi32(q, q); // Each 64 bit lane gets its quadrant twice,so the compares below fill whole lanes.
+    __m128d odd = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128d negative = _mm_castsi128_pd(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+    return _mm_xor_pd(select_pd(odd, c, s), _mm_and_pd(negative, _mm_set1_pd(-0.0)));
+}
+
+#define SINCOS_MAX 1e5 // Keeps k within 20 bits,so k * PIO2_1 is exact.
+
+static __m128d sin_pd(__m128d x)
+{
+    return sincos_pd(x, 0);
+}
+
+static __m128d cos_pd(__m128d x)
+{
+    return sincos_pd(x, 1);
+}
+
+// vop on pairs of elements,but sop on every element outside [lo,hi](NaNs too).An odd last element is run
+// as a pair with itself,so an element gets the same result wherever it sits in the array.
+static void run_kernel(double *out, const double *in, size_t n, VecFn vop, MathFn1 sop, double lo, double hi)
+{
+    __m128d vlo = _mm_set1_pd(lo), vhi = _mm_set1_pd(hi);
+    for (size_t i = 0; i < n; i += 2)
+    {
+        int pair = i + 1 < n;
+        __m128d x = pair ? _mm_loadu_pd(in + i) : _mm_set1_pd(in[i]);
+        int ok = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(x, vlo), _mm_cmple_pd(x, vhi)));
+        if (ok == 3 && pair)
+        {
+            _mm_storeu_pd(out + i, vop(x));
+            continue;
+        }
+        double r[2];
+        _mm_storeu_pd(r, vop(x));
+        out[i] = ok & 1 ? r[0] : sop(in[i]);
+        if (pair)
+            out[i + 1] = ok & 2 ? r[1] : sop(in[i + 1]);
+    }
+}
+
+#define DEFINE_KERNEL(name, vop, sop, lo, hi)                              \
+    void math_kernel_##name(double *out, const double *in, size_t n)      \
+    {                                                                      \
+        run_kernel(out, in, n, vop, sop, lo, hi);                          \
+    }
+#else
+#define DEFINE_KERNEL(name, vop, sop, lo, hi)                              \
+    void math_kernel_##name(double *out, const double *in, size_t n)      \
+    {                                                                      \
+        for (size_t i = 0; i < n; i++)                                     \
+            out[i] = sop(in[i]);                                           \
+    }
+#endif
+
+DEFINE_KERNEL(sqrt, sqrt_pd, sqrt, -INFINITY, INFINITY)
+DEFINE_KERNEL(abs, abs_pd, fabs, -INFINITY, INFINITY)
+DEFINE_KERNEL(floor, floor_pd, floor, -INFINITY, INFINITY)
+DEFINE_KERNEL(ceil, ceil_pd, ceil, -INFINITY, INFINITY)
+DEFINE_KERNEL(trunc, trunc_pd, trunc, -INFINITY, INFINITY)
+DEFINE_KERNEL(round, round_pd, round, -INFINITY, INFINITY)
+DEFINE_KERNEL(exp, exp_pd, exp, -708.0, 709.0)
+DEFINE_KERNEL(log, log_pd, log, 2.2250738585072014e-308, 1.7976931348623157e308)
+DEFINE_KERNEL(sin, sin_pd, sin, -SINCOS_MAX, SINCOS_MAX)
+DEFINE_KERNEL(cos, cos_pd, cos, -SINCOS_MAX, SINCOS_MAX)
+
+static ArrayObj *result_array(RuntimeVal *arr) // Reuses the argument's buffer when nothing else holds it.
+{
+    ArrayObj *in = (ArrayObj *)VAL_AS_OBJ(*arr);
+    if (__atomic_load_n(&in->obj.refcount, __ATOMIC_ACQUIRE) == 1)
+    {
+        *arr = runtimeval_null(); // Handed over to the caller.
+        return in;
+    }
+    return array_alloc(in->length);
+}
+
+RuntimeVal math_call1(const Builtin *builtin, RuntimeVal arg)
+{
+    if (VAL_IS_NUMBER(arg))
+        return runtimeval_number(builtin->unary(VAL_AS_NUMBER(arg)));
+    if (VAL_IS_NUMERIC(arg))
+    {
+        double x = VAL_TO_DOUBLE(arg);
+        free_value(&arg);
+        return runtimeval_number(builtin->unary(x));
+    }
+    if (!VAL_IS_ARRAY(arg))
+    {
+        fprintf(stderr, "Argument 1 of %s must be a number or an array.\n", builtin->name);
+        exit(EXIT_FAILURE);
+    }
+    ArrayObj *in = (ArrayObj *)VAL_AS_OBJ(arg);
+    ArrayObj *out = result_array(&arg);
+    if (builtin->kernel)
+    {
+        builtin->kernel(out->data, in->data, in->length);
+    }
+    else
+    {
+        for (size_t i = 0; i < in->length; i++)
+            out->data[i] = builtin->unary(in->data[i]);
+    }
+    free_value(&arg);
+    return runtimeval_array(out);
+}
+
+static double scalar_arg(RuntimeVal v, const Builtin *builtin, size_t i)
+{
+    if (!VAL_IS_NUMERIC(v))
+    {
+        fprintf(stderr, "Argument %zu of %s must be a number or an array.\n", i + 1, builtin->name);
+        exit(EXIT_FAILURE);
+    }
+    return VAL_TO_DOUBLE(v);
+}
+
+RuntimeVal math_call2(const Builtin *builtin, RuntimeVal left, RuntimeVal right)
+{
+    if (!VAL_IS_ARRAY(left) && !VAL_IS_ARRAY(right))
+    {
+        RuntimeVal ret = runtimeval_number(builtin->binary(scalar_arg(left, builtin, 0), scalar_arg(right, builtin, 1)));
+        free_value(&left);
+        free_value(&right);
+        return ret;
+    }
+    ArrayObj *l = VAL_IS_ARRAY(left) ? (ArrayObj *)VAL_AS_OBJ(left) : NULL;
+    ArrayObj *r = VAL_IS_ARRAY(right) ? (ArrayObj *)VAL_AS_OBJ(right) : NULL;
+    if (l && r && l->length != r->length)
+    {
+        fprintf(stderr, "Array length mismatch for %s: %zu and %zu.\n", builtin->name, l->length, r->length);
+        exit(EXIT_FAILURE);
+    }
+    double ls = l ? 0 : scalar_arg(left, builtin, 0), rs = r ? 0 : scalar_arg(right, builtin, 1);
+    ArrayObj *out = l ? result_array(&left) : result_array(&right);
+    for (size_t i = 0; i < out->length; i++)
+        out->data[i] = builtin->binary(l ? l->data[i] : ls, r ? r->data[i] : rs);
+    free_value(&left);
+    free_value(&right);
+    return runtimeval_array(out);
+}
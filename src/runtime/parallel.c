@@ -0,0 +1,564 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "frontend/ast.h"
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "runtime/interpreter.h"
+#include "runtime/threadpool.h"
+#include "runtime/parallel.h"
+#include "runtime/reactive.h"
+#include "runtime/rope.h"
+#include "runtime/builtins.h"
+
+#define PARALLEL_MIN_COST (1 << 16) // Below this a round is cheaper to just run inline.
+#define NO_DEP ((size_t)-1)
+
+typedef struct
+{
+    ValueType type;
+    int known; // number holds the actual value(literals and bound variables).
+    double number;
+    size_t length; // Length of the resulting string,when type is VAL_String.
+    size_t cost;
+} ExprInfo;
+
+int expr_is_pure(Expr *expr)
+{
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+    case EXPR_StringLiteral:
+    case EXPR_Identifier:
+        return 1;
+    case EXPR_UnaryExpr:
+        return expr_is_pure(expr->data.ue.on);
+    case EXPR_BinaryExpr:
+        return expr_is_pure(expr->data.be.left) && expr_is_pure(expr->data.be.right);
+    case EXPR_AssignmentExpr:
+        return 0;
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+        {
+            if (!expr_is_pure(expr->data.arr.elements[i]))
+                return 0;
+        }
+        return 1;
+    case EXPR_IndexExpr:
+        return expr_is_pure(expr->data.idx.target) && expr_is_pure(expr->data.idx.index);
+    case EXPR_CallExpr:
+    {
+        const Builtin *builtin = find_builtin(expr->data.call.callee);
+        if (builtin && builtin->writes)
+            return 0;
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+        {
+            if (!expr_is_pure(expr->data.call.args[i]))
+                return 0;
+        }
+        return 1;
+    }
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            if (!expr_is_pure(expr->data.map.keys[i]) || !expr_is_pure(expr->data.map.values[i]))
+                return 0;
+        }
+        return 1;
+    case EXPR_MemberExpr:
+        return expr_is_pure(expr->data.mem.object);
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+        {
+            if (!expr_is_pure(expr->data.rec.values[i]))
+                return 0;
+        }
+        return 1;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+        {
+            if (!expr_is_pure(expr->data.tpl.holes[i]))
+                return 0;
+        }
+        return 1;
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in expr_is_pure.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int stmt_is_pure(Stmt *stmt)
+{
+    switch (stmt->kind)
+    {
+    case NODE_ExprStmt:
+        return expr_is_pure(stmt->data.e);
+    case NODE_VariableDeclarationStmt:
+        return !stmt->data.vds.value || expr_is_pure(stmt->data.vds.value);
+    default:
+        fprintf(stderr, "Exhaustive handling of NodeType in stmt_is_pure.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static int is_numeric(ValueType type)
+{
+    return type == VAL_Number || type == VAL_Integer;
+}
+
+static int is_repeat_count(ExprInfo info)
+{
+    return info.known && info.number >= 0 && info.number <= INT_MAX && (int)info.number == info.number;
+}
+
+// Mirrors the type rules of eval_unary_expr/eval_binary_expr,answering "could this exit()?" without evaluating.
+static int analyze(Expr *expr, Scope *scope, ExprInfo *info)
+{
+    ExprInfo l, r;
+    info->known = 0;
+    info->length = 0;
+    info->cost = 1;
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+        info->type = VAL_Integer;
+        info->known = 1;
+        info->number = expr->data.n.digits ? strtod(expr->data.n.digits, NULL) : expr->data.n.x;
+        return 1;
+    case EXPR_StringLiteral:
+        info->type = VAL_String;
+        info->length = strlen(expr->data.s.s);
+        return 1;
+    case EXPR_Identifier:
+    {
+        Scope *s;
+        size_t idx;
+        if (!resolve(scope, expr->data.i.symbol, &s, &idx) || (s->cells && s->cells[idx]))
+            return 0; // Reading a cell can recompute it,which writes.
+        RuntimeVal val = s->values[idx];
+        info->type = VAL_TYPE(val);
+        if (VAL_IS_NUMERIC(val))
+        {
+            info->known = 1;
+            info->number = VAL_TO_DOUBLE(val);
+        }
+        else if (VAL_IS_STRING(val))
+        {
+            info->length = VAL_STRING_LENGTH(val);
+        }
+        return 1;
+    }
+    case EXPR_UnaryExpr:
+        if (!analyze(expr->data.ue.on, scope, &l))
+            return 0;
+        info->cost += l.cost;
+        switch (expr->data.ue.op)
+        {
+        case '!':
+            info->type = VAL_Bool;
+            return 1;
+        case '-':
+            info->type = l.type == VAL_Integer ? VAL_Number : l.type; // -INT64_MIN promotes.
+            info->known = l.known && is_numeric(l.type);
+            info->number = -l.number;
+            return is_numeric(l.type) || l.type == VAL_Bool;
+        case '~':
+            info->type = l.type == VAL_Bool ? VAL_Bool : VAL_Integer;
+            return l.type == VAL_Bool || l.type == VAL_Integer || (l.type == VAL_Number && l.known && floor(l.number) == l.number && fabs(l.number) < 9223372036854775808.0);
+        default:
+            return 0;
+        }
+    case EXPR_BinaryExpr:
+    {
+        char *op = expr->data.be.op;
+        if (!analyze(expr->data.be.left, scope, &l) || !analyze(expr->data.be.right, scope, &r))
+            return 0;
+        info->cost += l.cost + r.cost;
+        info->type = VAL_Bool;
+        if (l.type == VAL_Null || r.type == VAL_Null)
+        {
+            info->type = VAL_Null;
+            return 1;
+        }
+        if (is_numeric(l.type) && is_numeric(r.type))
+        {
+            // Results go back to VAL_Number:integer overflow promotes,so nothing more is known about them.
+            if (!strcmp(op, "+") || !strcmp(op, "-") || !strcmp(op, "*") || !strcmp(op, "/"))
+            {
+                info->type = VAL_Number;
+                return 1;
+            }
+            return !strcmp(op, "==") || !strcmp(op, ">=") || !strcmp(op, "<=") || !strcmp(op, ">") || !strcmp(op, "<"); // % and bitwise ops can fail.
+        }
+        if (l.type == VAL_Bool && r.type == VAL_Bool)
+        {
+            return !strcmp(op, "==") || !strcmp(op, "!=");
+        }
+        if (l.type == VAL_String && r.type == VAL_String)
+        {
+            if (!strcmp(op, "+"))
+            {
+                info->type = VAL_String;
+                if (l.length > SIZE_MAX - r.length)
+                    return 0;
+                info->length = l.length + r.length;
+                info->cost += info->length <= ROPE_FLAT_MAX ? info->length : 1; // Longer results are rope nodes.
+                return 1;
+            }
+            if (!strcmp(op, "=="))
+            {
+                info->cost += l.length; // Equal lengths flatten both sides.
+                return 1;
+            }
+            return 0;
+        }
+        if ((is_numeric(l.type) && r.type == VAL_String) || (l.type == VAL_String && is_numeric(r.type)))
+        {
+            ExprInfo n = is_numeric(l.type) ? l : r;
+            ExprInfo s = is_numeric(l.type) ? r : l;
+            if (strcmp(op, "*") || !is_repeat_count(n) || (s.length && (size_t)n.number > SIZE_MAX / s.length))
+                return 0;
+            info->type = VAL_String;
+            info->length = (size_t)n.number * s.length;
+            info->cost += info->length <= ROPE_FLAT_MAX ? info->length : 1;
+            return 1;
+        }
+        if ((is_numeric(l.type) && r.type == VAL_Bool) || (l.type == VAL_Bool && is_numeric(r.type)))
+        {
+            return !strcmp(op, "==") || !strcmp(op, "<") || !strcmp(op, ">") || !strcmp(op, "<=") || !strcmp(op, ">=");
+        }
+        return !strcmp(op, "=="); // Mismatched types compare unequal.
+    }
+    case EXPR_CallExpr:
+    {
+        // A math builtin on numbers only ever returns a number(NaN at worst),other calls are checked at runtime.
+        const Builtin *builtin = find_builtin(expr->data.call.callee);
+        if (!builtin || !(builtin->unary || builtin->binary) || expr->data.call.argc != builtin->arity)
+            return 0;
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+        {
+            if (!analyze(expr->data.call.args[i], scope, &l) || !is_numeric(l.type))
+                return 0;
+            info->cost += l.cost;
+        }
+        info->type = VAL_Number;
+        return 1;
+    }
+    case EXPR_AssignmentExpr:
+    case EXPR_ArrayLiteral:
+    case EXPR_IndexExpr:
+    case EXPR_MapLiteral:
+    case EXPR_MemberExpr:
+    case EXPR_RecordLiteral:
+    case EXPR_TemplateLiteral:
+        return 0; // Element types,keys,fields and bounds are only checked at runtime.
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in analyze.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int expr_is_total(Expr *expr, Scope *scope)
+{
+    ExprInfo info;
+    return analyze(expr, scope, &info);
+}
+
+size_t parallel_segment_end(Program prog, size_t start)
+{
+    if (reactive_enabled || lazy_enabled || threadpool_size(threadpool_global()) < 2)
+        return start; // Declarations are cells in these modes,and getvar writes to them.
+    size_t end = start;
+    while (end < prog.len && stmt_is_pure(prog.body[end]))
+    {
+        end++;
+    }
+    return end;
+}
+
+/* ---------- dependency graph ---------- */
+
+// Maps a declared name to the index of the last statement in the segment that declared it.
+typedef struct
+{
+    char **names;
+    size_t *writers;
+    size_t cap;
+} WriterTable;
+
+static size_t hash_name(const char *s)
+{
+    size_t h = 14695981039346656037UL;
+    while (*s)
+    {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static void writers_init(WriterTable *t, size_t n)
+{
+    t->cap = 16;
+    while (t->cap < n * 2)
+        t->cap *= 2;
+    t->names = calloc(t->cap, sizeof(char *));
+    t->writers = malloc(sizeof(size_t) * t->cap);
+    if (!t->names || !t->writers)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during dependency analysis of program.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static size_t *writers_slot(WriterTable *t, char *name, int insert)
+{
+    size_t i = hash_name(name) & (t->cap - 1);
+    while (t->names[i])
+    {
+        if (!strcmp(t->names[i], name))
+            return &t->writers[i];
+        i = (i + 1) & (t->cap - 1);
+    }
+    if (!insert)
+        return NULL;
+    t->names[i] = name; // Borrowed from the AST,which outlives the table.
+    return &t->writers[i];
+}
+
+static void collect_deps(Expr *expr, WriterTable *t, size_t *lastdep)
+{
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+    case EXPR_StringLiteral:
+        break;
+    case EXPR_Identifier:
+    {
+        size_t *w = writers_slot(t, expr->data.i.symbol, 0);
+        if (w && (*lastdep == NO_DEP || *w > *lastdep))
+            *lastdep = *w;
+        break;
+    }
+    case EXPR_UnaryExpr:
+        collect_deps(expr->data.ue.on, t, lastdep);
+        break;
+    case EXPR_BinaryExpr:
+        collect_deps(expr->data.be.left, t, lastdep);
+        collect_deps(expr->data.be.right, t, lastdep);
+        break;
+    case EXPR_AssignmentExpr:
+        collect_deps(expr->data.a.assigne, t, lastdep);
+        collect_deps(expr->data.a.value, t, lastdep);
+        break;
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+            collect_deps(expr->data.arr.elements[i], t, lastdep);
+        break;
+    case EXPR_IndexExpr:
+        collect_deps(expr->data.idx.target, t, lastdep);
+        collect_deps(expr->data.idx.index, t, lastdep);
+        break;
+    case EXPR_CallExpr:
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+            collect_deps(expr->data.call.args[i], t, lastdep);
+        break;
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            collect_deps(expr->data.map.keys[i], t, lastdep);
+            collect_deps(expr->data.map.values[i], t, lastdep);
+        }
+        break;
+    case EXPR_MemberExpr:
+        collect_deps(expr->data.mem.object, t, lastdep);
+        break;
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+            collect_deps(expr->data.rec.values[i], t, lastdep);
+        break;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+            collect_deps(expr->data.tpl.holes[i], t, lastdep);
+        break;
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in collect_deps.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* ---------- scheduling ---------- */
+
+typedef enum
+{
+    STMT_Pending,
+    STMT_Evaluated,
+} StmtState;
+
+typedef struct
+{
+    Stmt **body;
+    size_t len;
+    Scope *scope;
+    size_t *lastdep; // Read-after-write is the only edge that matters,commits already happen in order.
+    StmtState *state;
+    RuntimeVal *results;
+    size_t *round; // The statements of the next round,added as they become ready.
+    size_t roundlen;
+    unsigned char *total; // Set once a statement is ready and known not to fail.
+    size_t *cost;
+    size_t *waiters; // First statement whose lastdep is k,NO_DEP for none.
+    size_t *nextwaiter; // The next one with the same lastdep.
+} Segment;
+
+static Expr *stmt_expr(Stmt *stmt)
+{
+    return stmt->kind == NODE_ExprStmt ? stmt->data.e : stmt->data.vds.value;
+}
+
+static void eval_task(void *arg, size_t idx)
+{
+    Segment *seg = arg;
+    size_t k = seg->round[idx];
+    Expr *expr = stmt_expr(seg->body[k]);
+    seg->results[k] = expr ? eval_expr(expr, seg->scope) : runtimeval_null();
+}
+
+static int is_total(Segment *seg, size_t k, size_t *cost)
+{
+    Expr *expr = stmt_expr(seg->body[k]);
+    ExprInfo info;
+    if (!expr)
+    {
+        *cost = 1;
+        return 1;
+    }
+    if (!analyze(expr, seg->scope, &info))
+        return 0;
+    *cost = info.cost;
+    return 1;
+}
+
+// Every input of k is in scope now,so what analyze says about it won't change:it's asked once.
+static void make_ready(Segment *seg, size_t k)
+{
+    if (!is_total(seg, k, &seg->cost[k]))
+        return; // Run in order once it's next to commit.
+    seg->total[k] = 1;
+    seg->round[seg->roundlen++] = k;
+}
+
+static RuntimeVal commit(Segment *seg, size_t k)
+{
+    Stmt *stmt = seg->body[k];
+    if (stmt->kind == NODE_ExprStmt)
+        return seg->results[k];
+    return declarevar_at(seg->scope, stmt->data.vds.slot, stmt->data.vds.ident, seg->results[k], stmt->data.vds.value ? stmt->data.vds.isConst : 0);
+}
+
+RuntimeVal eval_segment_parallel(Program prog, size_t start, size_t end, Scope *scope)
+{
+    Segment seg;
+    WriterTable writers;
+    RuntimeVal lastEvaled = runtimeval_null();
+    seg.body = prog.body + start;
+    seg.len = end - start;
+    seg.scope = scope;
+    seg.lastdep = malloc(sizeof(size_t) * seg.len);
+    seg.state = malloc(sizeof(StmtState) * seg.len);
+    seg.results = malloc(sizeof(RuntimeVal) * seg.len);
+    seg.round = malloc(sizeof(size_t) * seg.len);
+    seg.roundlen = 0;
+    seg.total = calloc(seg.len, 1);
+    seg.cost = malloc(sizeof(size_t) * seg.len);
+    seg.waiters = malloc(sizeof(size_t) * seg.len);
+    seg.nextwaiter = malloc(sizeof(size_t) * seg.len);
+    if (!seg.lastdep || !seg.state || !seg.results || !seg.round || !seg.total || !seg.cost || !seg.waiters || !seg.nextwaiter)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during dependency analysis of program.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    writers_init(&writers, seg.len);
+    for (size_t k = 0; k < seg.len; k++)
+    {
+        Stmt *stmt = seg.body[k];
+        seg.lastdep[k] = NO_DEP;
+        seg.state[k] = STMT_Pending;
+        seg.waiters[k] = NO_DEP;
+        if (stmt_expr(stmt))
+            collect_deps(stmt_expr(stmt), &writers, &seg.lastdep[k]);
+        if (stmt->kind == NODE_VariableDeclarationStmt)
+            *writers_slot(&writers, stmt->data.vds.ident, 1) = k;
+    }
+    free(writers.names);
+    free(writers.writers);
+    for (size_t k = seg.len; k-- > 0;) // Backwards,so every waiter list is in program order.
+    {
+        if (seg.lastdep[k] == NO_DEP)
+            continue;
+        seg.nextwaiter[k] = seg.waiters[seg.lastdep[k]];
+        seg.waiters[seg.lastdep[k]] = k;
+    }
+    for (size_t k = 0; k < seg.len; k++)
+    {
+        if (seg.lastdep[k] == NO_DEP)
+            make_ready(&seg, k);
+    }
+
+    size_t committed = 0;
+    while (committed < seg.len)
+    {
+        // Everything whose inputs are already in scope and that cannot fail goes in this round.
+        size_t roundlen = seg.roundlen;
+        size_t cost = 0;
+        for (size_t i = 0; i < roundlen; i++)
+            cost += seg.cost[seg.round[i]];
+        if (roundlen >= 2 && cost >= PARALLEL_MIN_COST)
+        {
+            threadpool_run(threadpool_global(), eval_task, &seg, roundlen);
+        }
+        else
+        {
+            for (size_t i = 0; i < roundlen; i++)
+                eval_task(&seg, i);
+        }
+        for (size_t i = 0; i < roundlen; i++)
+            seg.state[seg.round[i]] = STMT_Evaluated;
+        seg.roundlen = 0;
+
+        // Commit the evaluated prefix.A statement that might fail is only run once it is next in line,
+        // so the error it reports is the same one sequential evaluation would have reported.
+        while (committed < seg.len)
+        {
+            if (seg.state[committed] == STMT_Pending)
+            {
+                if (seg.total[committed])
+                    break; // Became ready,it's in the next round.
+                free_value(&lastEvaled);
+                lastEvaled = eval_stmt(seg.body[committed], scope);
+            }
+            else
+            {
+                free_value(&lastEvaled);
+                lastEvaled = commit(&seg, committed);
+            }
+            for (size_t k = seg.waiters[committed]; k != NO_DEP; k = seg.nextwaiter[k])
+                make_ready(&seg, k);
+            committed++;
+        }
+    }
+
+    free(seg.lastdep);
+    free(seg.state);
+    free(seg.results);
+    free(seg.round);
+    free(seg.total);
+    free(seg.cost);
+    free(seg.waiters);
+    free(seg.nextwaiter);
+    return lastEvaled;
+}
@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "frontend/ast.h"
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "runtime/interpreter.h"
+#include "runtime/reactive.h"
+#include "runtime/builtins.h"
+
+#define DEPSET_MIN 8 // Fewer deps than this are scanned.
+
+int reactive_enabled = 0;
+int lazy_enabled = 0;
+
+static _Thread_local Cell *tracking = NULL; // The derived binding currently being (re)computed.
+static Cell *forcing = NULL; // Innermost thunk being forced,named if evaluation exits.
+
+static Cell *make_cell(Scope *scope, size_t idx)
+{
+    Cell *cell = malloc(sizeof(Cell));
+    if (!cell)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during creation of reactive binding.\n");
+        exit(EXIT_FAILURE);
+    }
+    cell->scope = scope;
+    cell->idx = idx;
+    cell->expr = NULL;
+    cell->dirty = 0;
+    cell->lazy = 0;
+    cell->deps = NULL;
+    cell->depslen = cell->depscap = 0;
+    cell->depset = NULL;
+    cell->depsetcap = 0;
+    cell->dependents = NULL;
+    cell->dependentslen = cell->dependentscap = 0;
+    return cell;
+}
+
+static void attach(Scope *scope, size_t idx, Cell *cell)
+{
+    if (!scope->cells)
+    {
+        scope->cells = calloc(scope->cap, sizeof(Cell *));
+        if (!scope->cells)
+        {
+            fprintf(stderr, "Memory allocation error. Happened during creation of reactive binding.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    cell->scope = scope;
+    cell->idx = idx;
+    scope->cells[idx] = cell;
+}
+
+Cell *cell_of(Scope *scope, size_t idx)
+{
+    if (scope->cells && scope->cells[idx])
+        return scope->cells[idx];
+    Cell *cell = make_cell(scope, idx);
+    attach(scope, idx, cell);
+    return cell;
+}
+
+static void push_edge(Cell ***arr, size_t *len, size_t *cap, Cell *cell)
+{
+    if (*len == *cap)
+    {
+        *cap = *cap ? *cap * 2 : 4;
+        Cell **tmp = realloc(*arr, sizeof(Cell *) * *cap);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened during recording of reactive dependency.\n");
+            exit(EXIT_FAILURE);
+        }
+        *arr = tmp;
+    }
+    (*arr)[(*len)++] = cell;
+}
+
+static Cell **depset_slot(Cell *cell, Cell *src) // src's entry in cell->depset,or the empty one it would go in.
+{
+    size_t mask = cell->depsetcap - 1;
+    size_t i = (size_t)(((uintptr_t)src * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (cell->depset[i] && cell->depset[i] != src)
+        i = (i + 1) & mask;
+    return &cell->depset[i];
+}
+
+static void depset_build(Cell *cell) // At most a quarter full,so it takes as many deps again before the next rebuild.
+{
+    size_t cap = 4 * DEPSET_MIN;
+    while (cap < cell->depslen * 4)
+        cap *= 2;
+    free(cell->depset);
+    cell->depset = calloc(cap, sizeof(Cell *));
+    if (!cell->depset)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during recording of reactive dependency.\n");
+        exit(EXIT_FAILURE);
+    }
+    cell->depsetcap = cap;
+    for (size_t i = 0; i < cell->depslen; i++)
+        *depset_slot(cell, cell->deps[i]) = cell->deps[i];
+}
+
+// Records that cell reads src,on both sides.The two lists always hold the same edges,so checking deps is enough.
+static void link_cells(Cell *cell, Cell *src)
+{
+    if (!cell->depset && cell->depslen >= DEPSET_MIN)
+        depset_build(cell);
+    if (cell->depset)
+    {
+        if (*depset_slot(cell, src))
+            return;
+    }
+    else
+    {
+        for (size_t i = 0; i < cell->depslen; i++)
+        {
+            if (cell->deps[i] == src)
+                return;
+        }
+    }
+    push_edge(&cell->deps, &cell->depslen, &cell->depscap, src);
+    push_edge(&src->dependents, &src->dependentslen, &src->dependentscap, cell);
+    if (cell->depset && cell->depslen * 2 > cell->depsetcap)
+        depset_build(cell);
+    else if (cell->depset)
+        *depset_slot(cell, src) = src;
+}
+
+static void remove_edge(Cell **arr, size_t *len, Cell *cell)
+{
+    for (size_t i = 0; i < *len; i++)
+    {
+        if (arr[i] == cell)
+        {
+            arr[i] = arr[--*len];
+            return;
+        }
+    }
+}
+
+static void clear_deps(Cell *cell)
+{
+    for (size_t i = 0; i < cell->depslen; i++)
+    {
+        remove_edge(cell->deps[i]->dependents, &cell->deps[i]->dependentslen, cell);
+    }
+    cell->depslen = 0;
+    if (cell->depset)
+        memset(cell->depset, 0, sizeof(Cell *) * cell->depsetcap);
+}
+
+void cell_track_read(Scope *scope, size_t idx)
+{
+    if (!tracking)
+        return;
+    Cell *src = cell_of(scope, idx);
+    if (src == tracking)
+        return;
+    link_cells(tracking, src);
+}
+
+void cell_invalidate(Cell *cell)
+{
+    // A dirty cell's dependents are already dirty,so the walk stops there.
+    for (size_t i = 0; i < cell->dependentslen; i++)
+    {
+        Cell *d = cell->dependents[i];
+        if (!d->dirty)
+        {
+            d->dirty = 1;
+            cell_invalidate(d);
+        }
+    }
+}
+
+static RuntimeVal evaluate(Cell *cell)
+{
+    Cell *saved = tracking;
+    tracking = cell;
+    RuntimeVal val = eval_expr(cell->expr, cell->scope);
+    tracking = saved;
+    return val;
+}
+
+static void report_forcing(void)
+{
+    if (forcing)
+    {
+        fprintf(stderr, "Happened while evaluating lazy binding %s\n", forcing->scope->keys[forcing->idx]);
+    }
+}
+
+static RuntimeVal force(Cell *cell)
+{
+    static int registered = 0;
+    if (!registered)
+    {
+        atexit(report_forcing);
+        registered = 1;
+    }
+    Cell *saved = forcing;
+    forcing = cell;
+    RuntimeVal val = evaluate(cell);
+    forcing = saved;
+    return val;
+}
+
+void cell_refresh(Cell *cell)
+{
+    if (!cell->dirty || !cell->expr)
+        return;
+    clear_deps(cell);
+    RuntimeVal val = cell->lazy ? force(cell) : evaluate(cell);
+    free_value(&cell->scope->values[cell->idx]);
+    cell->scope->values[cell->idx] = val;
+    cell->dirty = 0;
+    if (cell->lazy)
+    {
+        cell_detach(cell); // Forced once,from now on it's just a value.
+        cell->lazy = 0;
+    }
+}
+
+void cell_force_thunks(Cell *cell)
+{
+    // Forcing can drop edges from cell->dependents,so rescan until no pending thunk is left.
+    size_t i = 0;
+    while (i < cell->dependentslen)
+    {
+        Cell *d = cell->dependents[i];
+        if (d->lazy && d->dirty)
+        {
+            cell_refresh(d);
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+}
+
+void cell_detach(Cell *cell)
+{
+    clear_deps(cell);
+    free_expr(cell->expr);
+    cell->expr = NULL;
+    cell->dirty = 0;
+}
+
+static int reads_variables(Expr *expr, int *reads)
+{
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+    case EXPR_StringLiteral:
+        return 1;
+    case EXPR_Identifier:
+        *reads = 1;
+        return 1;
+    case EXPR_UnaryExpr:
+        return reads_variables(expr->data.ue.on, reads);
+    case EXPR_BinaryExpr:
+        return reads_variables(expr->data.be.left, reads) && reads_variables(expr->data.be.right, reads);
+    case EXPR_AssignmentExpr:
+        return 0; // Side effects cannot be replayed.
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+        {
+            if (!reads_variables(expr->data.arr.elements[i], reads))
+                return 0;
+        }
+        return 1;
+    case EXPR_IndexExpr:
+        return reads_variables(expr->data.idx.target, reads) && reads_variables(expr->data.idx.index, reads);
+    case EXPR_CallExpr:
+    {
+        const Builtin *builtin = find_builtin(expr->data.call.callee);
+        if (builtin && builtin->writes)
+            return 0;
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+        {
+            if (!reads_variables(expr->data.call.args[i], reads))
+                return 0;
+        }
+        return 1;
+    }
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            if (!reads_variables(expr->data.map.keys[i], reads) || !reads_variables(expr->data.map.values[i], reads))
+                return 0;
+        }
+        return 1;
+    case EXPR_MemberExpr:
+        return reads_variables(expr->data.mem.object, reads);
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+        {
+            if (!reads_variables(expr->data.rec.values[i], reads))
+                return 0;
+        }
+        return 1;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+        {
+            if (!reads_variables(expr->data.tpl.holes[i], reads))
+                return 0;
+        }
+        return 1;
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in reads_variables.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+RuntimeVal declare_derived(Scope *scope, char *varname, Expr *expr, int isconst)
+{
+    int reads = 0;
+    if (!reads_variables(expr, &reads) || !reads)
+        return declarevar(scope, varname, eval_expr(expr, scope), isconst);
+
+    Cell *cell = make_cell(scope, 0);
+    cell->expr = clone_expr(expr); // The Program is freed after each REPL line.
+    RuntimeVal val = evaluate(cell);
+    RuntimeVal ret = declarevar(scope, varname, val, isconst);
+    attach(scope, scope->len - 1, cell);
+    return ret;
+}
+
+static void link_static_reads(Cell *cell, Expr *expr, Scope *scope)
+{
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+    case EXPR_StringLiteral:
+        break;
+    case EXPR_Identifier:
+    {
+        Scope *s;
+        size_t idx;
+        if (resolve(scope, expr->data.i.symbol, &s, &idx)) // Not for names map and friends bind.
+        {
+            Cell *src = cell_of(s, idx);
+            link_cells(cell, src);
+        }
+        break;
+    }
+    case EXPR_UnaryExpr:
+        link_static_reads(cell, expr->data.ue.on, scope);
+        break;
+    case EXPR_BinaryExpr:
+        link_static_reads(cell, expr->data.be.left, scope);
+        link_static_reads(cell, expr->data.be.right, scope);
+        break;
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+            link_static_reads(cell, expr->data.arr.elements[i], scope);
+        break;
+    case EXPR_IndexExpr:
+        link_static_reads(cell, expr->data.idx.target, scope);
+        link_static_reads(cell, expr->data.idx.index, scope);
+        break;
+    case EXPR_CallExpr:
+        for (size_t i = 0; i < expr->data.call.argc; i++)
+            link_static_reads(cell, expr->data.call.args[i], scope);
+        break;
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            link_static_reads(cell, expr->data.map.keys[i], scope);
+            link_static_reads(cell, expr->data.map.values[i], scope);
+        }
+        break;
+    case EXPR_MemberExpr:
+        link_static_reads(cell, expr->data.mem.object, scope);
+        break;
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+            link_static_reads(cell, expr->data.rec.values[i], scope);
+        break;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+            link_static_reads(cell, expr->data.tpl.holes[i], scope);
+        break;
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in link_static_reads.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+RuntimeVal declare_lazy(Scope *scope, char *varname, Expr *expr, int isconst)
+{
+    int reads = 0;
+    if (!reads_variables(expr, &reads))
+        return declarevar(scope, varname, eval_expr(expr, scope), isconst); // Assignments have to happen now.
+
+    Cell *cell = make_cell(scope, 0);
+    cell->expr = clone_expr(expr);
+    cell->dirty = 1;
+    cell->lazy = 1;
+    link_static_reads(cell, cell->expr, scope);
+    RuntimeVal placeholder = declarevar(scope, varname, runtimeval_null(), isconst);
+    attach(scope, scope->len - 1, cell);
+    return placeholder;
+}
+
+void cell_release(Cell *cell)
+{
+    for (size_t i = 0; i < cell->dependentslen; i++)
+    {
+        Cell *d = cell->dependents[i];
+        remove_edge(d->deps, &d->depslen, cell);
+        free(d->depset); // Rebuilt without cell when it's next needed.
+        d->depset = NULL;
+    }
+    cell->dependentslen = 0;
+}
+
+void free_cell(Cell *cell)
+{
+    if (!cell)
+        return;
+    free_expr(cell->expr);
+    free(cell->deps);
+    free(cell->depset);
+    free(cell->dependents);
+    free(cell);
+}
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "frontend/ast.h"
+#include "frontend/lexer.h"
+#include "runtime/values.h"
+#include "runtime/record.h"
+#include "runtime/slab.h"
+
+static pthread_mutex_t shapes_lock = PTHREAD_MUTEX_INITIALIZER; // Records can be built on the evaluation threads.
+static uint32_t next_shape_id = 1;
+
+static Shape *make_shape(Shape *parent, char *name)
+{
+    Shape *shape = malloc(sizeof(Shape));
+    size_t nfields = parent ? parent->nfields + 1 : 0;
+    char **names = malloc(sizeof(char *) * (nfields ? nfields : 1));
+    if (!shape || !names)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while creating record shape.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (parent)
+    {
+        memcpy(names, parent->names, sizeof(char *) * parent->nfields); // Shapes are never freed,sharing the names is fine.
+        names[nfields - 1] = my_str_dup(name);
+        if (!names[nfields - 1])
+        {
+            fprintf(stderr, "Memory allocation error. Happened while creating record shape.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    shape->id = next_shape_id++;
+    shape->parent = parent;
+    shape->nfields = nfields;
+    shape->names = names;
+    shape->children = NULL;
+    shape->nchildren = shape->childcap = 0;
+    return shape;
+}
+
+static Shape *root = NULL;
+static pthread_once_t root_once = PTHREAD_ONCE_INIT;
+
+static void make_root(void)
+{
+    pthread_mutex_lock(&shapes_lock);
+    root = make_shape(NULL, NULL);
+    pthread_mutex_unlock(&shapes_lock);
+}
+
+Shape *shape_root(void) // Never changes once made,so only making it takes the lock.
+{
+    pthread_once(&root_once, make_root);
+    return root;
+}
+
+Shape *shape_with(Shape *shape, char *name)
+{
+    pthread_mutex_lock(&shapes_lock);
+    for (size_t i = 0; i < shape->nchildren; i++)
+    {
+        Shape *child = shape->children[i];
+        if (!strcmp(child->names[child->nfields - 1], name))
+        {
+            pthread_mutex_unlock(&shapes_lock);
+            return child;
+        }
+    }
+    if (shape->nchildren == shape->childcap)
+    {
+        shape->childcap = shape->childcap ? shape->childcap * 2 : 2;
+        Shape **tmp = realloc(shape->children, sizeof(Shape *) * shape->childcap);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened while creating record shape.\n");
+            exit(EXIT_FAILURE);
+        }
+        shape->children = tmp;
+    }
+    Shape *child = make_shape(shape, name);
+    shape->children[shape->nchildren++] = child;
+    pthread_mutex_unlock(&shapes_lock);
+    return child;
+}
+
+static size_t shape_slot(const Shape *shape, const char *name) // shape->nfields when missing.
+{
+    for (size_t i = shape->nfields; i-- > 0;)
+    {
+        if (!strcmp(shape->names[i], name))
+            return i;
+    }
+    return shape->nfields;
+}
+
+RecordObj *record_alloc(Shape *shape)
+{
+    RecordObj *rec = slab_alloc(sizeof(RecordObj));
+    RuntimeVal *slots = slab_alloc(sizeof(RuntimeVal) * (shape->nfields ? shape->nfields : 1));
+    if (!rec || !slots)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating record.\n");
+        exit(EXIT_FAILURE);
+    }
+    rec->obj.refcount = 1;
+    rec->obj.kind = OBJ_Record;
+    rec->shape = shape;
+    rec->capacity = shape->nfields ? shape->nfields : 1;
+    rec->slots = slots;
+    return rec;
+}
+
+RecordObj *record_copy(const RecordObj *rec)
+{
+    RecordObj *ret = record_alloc(rec->shape);
+    for (size_t i = 0; i < rec->shape->nfields; i++)
+        ret->slots[i] = copy_value(rec->slots[i]);
+    return ret;
+}
+
+RuntimeVal runtimeval_record(RecordObj *rec)
+{
+    return runtimeval_obj(&rec->obj);
+}
+
+// An entry is the shape id in the top half and the slot in the bottom half,so one atomic load
+// always sees a matching pair even while another thread fills the cache in.
+static size_t cache_lookup(const uint64_t *cache, const Shape *shape)
+{
+    for (int i = 0; i < MEMBER_CACHE_SIZE; i++)
+    {
+        uint64_t entry = __atomic_load_n(&cache[i], __ATOMIC_RELAXED);
+        if ((uint32_t)(entry >> 32) == shape->id)
+            return (size_t)(uint32_t)entry;
+    }
+    return SIZE_MAX;
+}
+
+static void cache_insert(uint64_t *cache, const Shape *shape, size_t slot)
+{
+    uint64_t entry = (uint64_t)shape->id << 32 | (uint32_t)slot;
+    for (int i = 0; i < MEMBER_CACHE_SIZE; i++)
+    {
+        if (!__atomic_load_n(&cache[i], __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&cache[i], entry, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    __atomic_store_n(&cache[shape->id % MEMBER_CACHE_SIZE], entry, __ATOMIC_RELAXED); // Megamorphic,just evict one.
+}
+
+static size_t find_slot(const RecordObj *rec, const char *name, uint64_t *cache)
+{
+    size_t slot = cache_lookup(cache, rec->shape);
+    if (slot != SIZE_MAX)
+        return slot;
+    slot = shape_slot(rec->shape, name);
+    if (slot != rec->shape->nfields)
+        cache_insert(cache, rec->shape, slot);
+    return slot;
+}
+
+RuntimeVal *record_field(const RecordObj *rec, char *name, uint64_t *cache)
+{
+    size_t slot = find_slot(rec, name, cache);
+    return slot == rec->shape->nfields ? NULL : &rec->slots[slot];
+}
+
+void record_set(RecordObj *rec, char *name, RuntimeVal value, uint64_t *cache)
+{
+    size_t slot = find_slot(rec, name, cache);
+    if (slot != rec->shape->nfields)
+    {
+        free_value(&rec->slots[slot]);
+        rec->slots[slot] = value;
+        return;
+    }
+    Shape *shape = shape_with(rec->shape, name);
+    if (shape->nfields > rec->capacity)
+    {
+        size_t capacity = rec->capacity * 2;
+        RuntimeVal *tmp = slab_realloc(rec->slots, sizeof(RuntimeVal) * capacity);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened while adding field %s to record.\n", name);
+            exit(EXIT_FAILURE);
+        }
+        rec->slots = tmp;
+        rec->capacity = capacity;
+    }
+    rec->slots[slot] = value;
+    rec->shape = shape;
+}
+
+void dump_record(const RecordObj *rec)
+{
+    printf("{");
+    for (size_t i = 0; i < rec->shape->nfields; i++)
+    {
+        printf(i ? ", %s = " : "%s = ", rec->shape->names[i]);
+        print_nested_value(rec->slots[i]);
+    }
+    printf("}");
+}
+
+void free_record(RecordObj *rec)
+{
+    for (size_t i = 0; i < rec->shape->nfields; i++)
+        free_value(&rec->slots[i]);
+    slab_free(rec->slots);
+    slab_free(rec);
+}
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frontend/ast.h"
+#include "runtime/scope.h"
+#include "runtime/builtins.h"
+#include "runtime/resolver.h"
+
+// A scope as the resolver sees it,one per scope the expression will be evaluated in.
+typedef struct Frame
+{
+    Scope *live; // The scope itself when it exists already,NULL for one made during evaluation(a map's names).
+    Scope pending; // Declared by the program but not in live yet,their slots come after live's.Values are all null.
+    struct Frame *parent;
+} Frame;
+
+typedef struct
+{
+    Frame *top; // The scope the program runs in.
+    // Slots in top's pending,which are only final once every write to a frozen variable has been copied into top.live.
+    size_t **fixups;
+    size_t fixupslen;
+    size_t fixupscap;
+} Resolver;
+
+static void add_fixup(Resolver *r, size_t *slot)
+{
+    if (r->fixupslen == r->fixupscap)
+    {
+        r->fixupscap = r->fixupscap ? r->fixupscap * 2 : 64;
+        size_t **tmp = realloc(r->fixups, sizeof(size_t *) * r->fixupscap);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened while resolving variables.\n");
+            exit(EXIT_FAILURE);
+        }
+        r->fixups = tmp;
+    }
+    r->fixups[r->fixupslen++] = slot;
+}
+
+// *where is the frame or live scope the variable was found in,*from is NULL when it's in a frame's pending.
+static int lookup(Frame *frame, const char *name, size_t *depth, size_t *slot, Frame **where, Scope **from)
+{
+    size_t d = 0;
+    Frame *last = frame;
+    for (; frame; frame = frame->parent, d++)
+    {
+        size_t i = frame->live ? find_var(frame->live, name) : VAR_UNRESOLVED;
+        *from = frame->live;
+        if (i == VAR_UNRESOLVED)
+        {
+            i = find_var(&frame->pending, name);
+            *from = NULL;
+        }
+        if (i == VAR_UNRESOLVED)
+        {
+            last = frame;
+            continue;
+        }
+        *depth = d;
+        *slot = i;
+        *where = frame;
+        return 1;
+    }
+    // Above the scope the program runs in,nothing new gets declared.
+    for (Scope *s = last->live ? last->live->parent : NULL; s; s = s->parent, d++)
+    {
+        size_t i = find_var(s, name);
+        if (i != VAR_UNRESOLVED)
+        {
+            *depth = d;
+            *slot = i;
+            *where = NULL;
+            *from = s;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void resolve_var(Identifier *var, Frame *frame, Resolver *r, int writes)
+{
+    size_t depth, slot;
+    Frame *where;
+    Scope *from;
+    if (!lookup(frame, var->symbol, &depth, &slot, &where, &from))
+    {
+        fprintf(stderr, "Cannot resolve variable %s\n", var->symbol);
+        exit(EXIT_FAILURE);
+    }
+    if (writes && (from ? from->isconst[slot] : where->pending.isconst[slot]))
+    {
+        fprintf(stderr, "Reassignment to constant variable %s\n", var->symbol);
+        exit(EXIT_FAILURE);
+    }
+    if (writes && from && from->frozen)
+    {
+        // Copied now rather than on the first write,so the declarations after it know their slots.
+        shadowed(r->top->live, from, &slot, 1);
+        for (depth = 0; frame != r->top; frame = frame->parent)
+            depth++;
+    }
+    var->depth = depth;
+    var->slot = slot;
+    if (where == r->top && !from)
+        add_fixup(r, &var->slot);
+}
+
+static void resolve_expr(Expr *expr, Frame *frame, Resolver *r);
+
+// The variable an assignment writes,when it is one.Anything else the interpreter rejects itself.
+static void resolve_target(Expr *expr, Frame *frame, Resolver *r)
+{
+    if (expr->kind == EXPR_Identifier)
+        resolve_var(&expr->data.i, frame, r, 1);
+    else
+        resolve_expr(expr, frame, r);
+}
+
+static void resolve_call(CallExpr *call, Frame *frame, Resolver *r)
+{
+    const Builtin *b = find_builtin(call->callee);
+    if (!b || call->argc != b->arity)
+        return; // An error when it's called.
+    if (!b->binds)
+    {
+        for (size_t i = 0; i < call->argc; i++)
+        {
+            if (i == 0 && b->writes)
+                resolve_target(call->args[0], frame, r);
+            else
+                resolve_expr(call->args[i], frame, r);
+        }
+        return;
+    }
+    resolve_expr(call->args[0], frame, r);
+    Frame inner;
+    inner.live = NULL;
+    inner.parent = frame;
+    for (size_t i = 1; i <= b->binds; i++)
+    {
+        Expr *name = call->args[i];
+        if (name->kind != EXPR_Identifier || (i > 1 && !strcmp(name->data.i.symbol, call->args[1]->data.i.symbol)))
+            return; // Reported when it's called,after the array.
+    }
+    inner.pending = new_scope(NULL);
+    for (size_t i = 1; i <= b->binds; i++)
+        declarevar(&inner.pending, call->args[i]->data.i.symbol, runtimeval_null(), 0);
+    resolve_expr(call->args[b->binds + 1], &inner, r);
+    free_scope(&inner.pending);
+}
+
+static void resolve_expr(Expr *expr, Frame *frame, Resolver *r)
+{
+    switch (expr->kind)
+    {
+    case EXPR_NumericLiteral:
+    case EXPR_StringLiteral:
+        break;
+    case EXPR_Identifier:
+        resolve_var(&expr->data.i, frame, r, 0);
+        break;
+    case EXPR_UnaryExpr:
+        resolve_expr(expr->data.ue.on, frame, r);
+        break;
+    case EXPR_BinaryExpr:
+        resolve_expr(expr->data.be.left, frame, r);
+        resolve_expr(expr->data.be.right, frame, r);
+        break;
+    case EXPR_AssignmentExpr:
+    {
+        Expr *assigne = expr->data.a.assigne;
+        if (assigne->kind == EXPR_IndexExpr)
+        {
+            resolve_target(assigne->data.idx.target, frame, r);
+            resolve_expr(assigne->data.idx.index, frame, r);
+        }
+        else if (assigne->kind == EXPR_MemberExpr)
+        {
+            resolve_target(assigne->data.mem.object, frame, r);
+        }
+        else
+        {
+            resolve_target(assigne, frame, r);
+        }
+        resolve_expr(expr->data.a.value, frame, r);
+        break;
+    }
+    case EXPR_ArrayLiteral:
+        for (size_t i = 0; i < expr->data.arr.len; i++)
+            resolve_expr(expr->data.arr.elements[i], frame, r);
+        break;
+    case EXPR_IndexExpr:
+        resolve_expr(expr->data.idx.target, frame, r);
+        resolve_expr(expr->data.idx.index, frame, r);
+        break;
+    case EXPR_CallExpr:
+        resolve_call(&expr->data.call, frame, r);
+        break;
+    case EXPR_MapLiteral:
+        for (size_t i = 0; i < expr->data.map.len; i++)
+        {
+            resolve_expr(expr->data.map.keys[i], frame, r);
+            resolve_expr(expr->data.map.values[i], frame, r);
+        }
+        break;
+    case EXPR_MemberExpr:
+        resolve_expr(expr->data.mem.object, frame, r);
+        break;
+    case EXPR_RecordLiteral:
+        for (size_t i = 0; i < expr->data.rec.len; i++)
+            resolve_expr(expr->data.rec.values[i], frame, r);
+        break;
+    case EXPR_TemplateLiteral:
+        for (size_t i = 0; i < expr->data.tpl.nholes; i++)
+            resolve_expr(expr->data.tpl.holes[i], frame, r);
+        break;
+    default:
+        fprintf(stderr, "Exhaustive handling of ExprType in resolve_expr.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void resolve_program(Program prog, Scope *scope)
+{
+    Frame top;
+    top.live = scope;
+    top.pending = new_scope(NULL);
+    top.parent = NULL;
+    Resolver r = {&top, NULL, 0, 0};
+    for (size_t i = 0; i < prog.len; i++)
+    {
+        Stmt *stmt = prog.body[i];
+        switch (stmt->kind)
+        {
+        case NODE_ExprStmt:
+            resolve_expr(stmt->data.e, &top, &r);
+            break;
+        case NODE_VariableDeclarationStmt:
+        {
+            VariableDeclarationStmt *vds = &stmt->data.vds;
+            if (vds->value) // Before the name is declared,lazy or not,so an initializer only sees what came before it.
+                resolve_expr(vds->value, &top, &r);
+            if (is_declared(scope, vds->ident) || find_var(&top.pending, vds->ident) != VAR_UNRESOLVED)
+            {
+                fprintf(stderr, "Cannot redeclare already declared variable: %s\n", vds->ident);
+                exit(EXIT_FAILURE);
+            }
+            vds->slot = top.pending.len;
+            add_fixup(&r, &vds->slot);
+            declarevar(&top.pending, vds->ident, runtimeval_null(), vds->value ? vds->isConst : 0);
+            break;
+        }
+        default:
+            fprintf(stderr, "Exhaustive handling of NodeType in resolve_program.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < r.fixupslen; i++)
+        *r.fixups[i] += scope->len; // Declarations go after everything in scope now.
+    free(r.fixups);
+    free_scope(&top.pending);
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "runtime/values.h"
+#include "runtime/rope.h"
+#include "runtime/slab.h"
+
+static RopeObj *as_rope(RuntimeVal str) // NULL for flat strings.
+{
+    if (!VAL_IS_HEAP_STRING(str))
+        return NULL;
+    Obj *obj = VAL_AS_OBJ(str);
+    return obj->kind == OBJ_Rope ? (RopeObj *)obj : NULL;
+}
+
+size_t string_length(RuntimeVal str)
+{
+    if (VAL_IS_SHORT_STRING(str) || VAL_AS_OBJ(str)->kind == OBJ_Slice)
+        return VAL_AS_STRING(&str).length; // Both are viewed without copying anything.
+    RopeObj *rope = as_rope(str);
+    return rope ? rope->length : VAL_AS_STRING_OBJ(str)->length;
+}
+
+static uint32_t height(RuntimeVal str)
+{
+    RopeObj *rope = as_rope(str);
+    return rope ? rope->height : 0;
+}
+
+static RopeObj *alloc_rope(RopeKind kind, size_t length)
+{
+    RopeObj *rope = slab_alloc(sizeof(RopeObj));
+    if (!rope)
+    {
+        fprintf(stderr,"Memory allocation error. Happened while allocating rope of length %zu.\n", length);
+        exit(EXIT_FAILURE);
+    }
+    rope->obj.refcount = 1;
+    rope->obj.kind = OBJ_Rope;
+    rope->length = length;
+    rope->kind = kind;
+    rope->height = 0;
+    rope->left = runtimeval_null();
+    rope->right = runtimeval_null();
+    rope->count = 0;
+    rope->flat = NULL;
+    return rope;
+}
+
+static RuntimeVal make_concat(RuntimeVal left, RuntimeVal right) // Takes over both references.
+{
+    RopeObj *rope = alloc_rope(ROPE_Concat, string_length(left) + string_length(right));
+    uint32_t hl = height(left), hr = height(right);
+    rope->height = (hl > hr ? hl : hr) + 1;
+    rope->left = left;
+    rope->right = right;
+    return runtimeval_string_obj((StringObj *)rope);
+}
+
+static RuntimeVal concat_flat(RuntimeVal left, RuntimeVal right) // Borrows both.
+{
+    StringVal l = VAL_AS_STRING(&left);
+    StringVal r = VAL_AS_STRING(&right);
+    size_t total = l.length + r.length;
+    if (total <= VAL_SHORT_STRING_MAX)
+    {
+        char buf[VAL_SHORT_STRING_MAX];
+        memcpy(buf, l.chars, l.length);
+        memcpy(buf + l.length, r.chars, r.length);
+        return runtimeval_string_len(buf, total);
+    }
+    StringObj *str = string_alloc(total);
+    memcpy(str->chars, l.chars, l.length);
+    memcpy(str->chars + l.length, r.chars, r.length);
+    return runtimeval_string_obj(str);
+}
+
+// AVL join:walks down the taller side until the heights are within one,rotating on the way back up.
+static RuntimeVal join(RuntimeVal left, RuntimeVal right) // Takes over both references.
+{
+    uint32_t hl = height(left), hr = height(right);
+    if (hl > hr + 1)
+    {
+        RopeObj *l = as_rope(left);
+        RuntimeVal outer = copy_value(l->left);
+        RuntimeVal t = join(copy_value(l->right), right);
+        free_value(&left);
+        if (height(t) <= height(outer) + 1)
+            return make_concat(outer, t);
+        RopeObj *tr = as_rope(t);
+        RuntimeVal inner = copy_value(tr->left), far = copy_value(tr->right);
+        free_value(&t);
+        if (height(inner) <= height(far))
+            return make_concat(make_concat(outer, inner), far);
+        RopeObj *m = as_rope(inner);
+        RuntimeVal ml = copy_value(m->left), mr = copy_value(m->right);
+        free_value(&inner);
+        return make_concat(make_concat(outer, ml), make_concat(mr, far));
+    }
+    if (hr > hl + 1)
+    {
+        RopeObj *r = as_rope(right);
+        RuntimeVal outer = copy_value(r->right);
+        RuntimeVal t = join(left, copy_value(r->left));
+        free_value(&right);
+        if (height(t) <= height(outer) + 1)
+            return make_concat(t, outer);
+        RopeObj *tl = as_rope(t);
+        RuntimeVal far = copy_value(tl->left), inner = copy_value(tl->right);
+        free_value(&t);
+        if (height(inner) <= height(far))
+            return make_concat(far, make_concat(inner, outer));
+        RopeObj *m = as_rope(inner);
+        RuntimeVal ml = copy_value(m->left), mr = copy_value(m->right);
+        free_value(&inner);
+        return make_concat(make_concat(far, ml), make_concat(mr, outer));
+    }
+    return make_concat(left, right);
+}
+
+// Merges a short flat piece into the first/last leaf of tree when that leaf is flat and has room.
+// Only the path down to the leaf is copied and no height changes,so the tree stays balanced.
+static int merge_into_edge(RuntimeVal tree, RuntimeVal piece, size_t piecelen, int append, RuntimeVal *out)
+{
+    RopeObj *rope = as_rope(tree);
+    if (!rope)
+    {
+        if (string_length(tree) + piecelen > ROPE_FLAT_MAX)
+            return 0;
+        *out = append ? concat_flat(tree, piece) : concat_flat(piece, tree);
+        return 1;
+    }
+    if (rope->kind != ROPE_Concat)
+        return 0;
+    RuntimeVal edge;
+    if (!merge_into_edge(append ? rope->right : rope->left, piece, piecelen, append, &edge))
+        return 0;
+    *out = append ? make_concat(copy_value(rope->left), edge) : make_concat(edge, copy_value(rope->right));
+    return 1;
+}
+
+RuntimeVal string_concat(RuntimeVal left, RuntimeVal right)
+{
+    size_t llen = string_length(left), rlen = string_length(right);
+    if (llen > SIZE_MAX - rlen)
+    {
+        fprintf(stderr, "String concatenation of lengths %zu and %zu is too long.\n", llen, rlen);
+        exit(EXIT_FAILURE);
+    }
+    if (llen + rlen <= ROPE_FLAT_MAX)
+        return concat_flat(left, right);
+    if (!llen)
+        return copy_value(right);
+    if (!rlen)
+        return copy_value(left);
+
+    RuntimeVal ret;
+    if (rlen < ROPE_FLAT_MAX && !as_rope(right) && merge_into_edge(left, right, rlen, 1, &ret))
+        return ret;
+    if (llen < ROPE_FLAT_MAX && !as_rope(left) && merge_into_edge(right, left, llen, 0, &ret))
+        return ret;
+    return join(copy_value(left), copy_value(right));
+}
+
+static void repeat_chars(char *buf, size_t len, size_t total)
+{
+    // First instance is already there,keep doubling it.
+    size_t copied = len;
+    while (copied < total)
+    {
+        size_t to_copy = (copied > total - copied) ? total - copied : copied;
+        memcpy(buf + copied, buf, to_copy);
+        copied += to_copy;
+    }
+}
+
+RuntimeVal string_repeat(RuntimeVal str, size_t count)
+{
+    size_t len = string_length(str);
+    if (len && count > SIZE_MAX / len)
+    {
+        fprintf(stderr, "String repetition of length %zu by %zu is too long.\n", len, count);
+        exit(EXIT_FAILURE);
+    }
+    size_t total = len * count;
+    if (total <= ROPE_FLAT_MAX)
+    {
+        char small[VAL_SHORT_STRING_MAX];
+        StringObj *flat = total <= VAL_SHORT_STRING_MAX ? NULL : string_alloc(total);
+        char *buf = flat ? flat->chars : small;
+        if (total)
+        {
+            StringVal view = VAL_AS_STRING(&str);
+            memcpy(buf, view.chars, len);
+            repeat_chars(buf, len, total);
+        }
+        return flat ? runtimeval_string_obj(flat) : runtimeval_string_len(small, total);
+    }
+    if (count == 1)
+        return copy_value(str);
+    RopeObj *rope = alloc_rope(ROPE_Repeat, total);
+    rope->left = copy_value(str);
+    rope->count = count;
+    return runtimeval_string_obj((StringObj *)rope);
+}
+
+static void write_chars(RuntimeVal str, char *dst)
+{
+    RopeObj *rope = as_rope(str);
+    if (!rope)
+    {
+        StringVal view = VAL_AS_STRING(&str);
+        memcpy(dst, view.chars, view.length);
+        return;
+    }
+    StringObj *flat = __atomic_load_n(&rope->flat, __ATOMIC_ACQUIRE);
+    if (flat)
+    {
+        memcpy(dst, flat->chars, rope->length);
+        return;
+    }
+    if (rope->kind == ROPE_Concat)
+    {
+        write_chars(rope->left, dst);
+        write_chars(rope->right, dst + string_length(rope->left));
+        return;
+    }
+    write_chars(rope->left, dst);
+    repeat_chars(dst, string_length(rope->left), rope->length);
+}
+
+StringObj *rope_flatten(RopeObj *rope)
+{
+    StringObj *flat = __atomic_load_n(&rope->flat, __ATOMIC_ACQUIRE);
+    if (flat)
+        return flat;
+    flat = string_alloc(rope->length);
+    write_chars(runtimeval_string_obj((StringObj *)rope), flat->chars);
+    // Two threads can flatten the same rope during parallel evaluation,the first copy wins.
+    StringObj *expected = NULL;
+    if (!__atomic_compare_exchange_n(&rope->flat, &expected, flat, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        slab_free(flat);
+        return expected;
+    }
+    return flat;
+}
+
+void free_rope(RopeObj *rope)
+{
+    free_value(&rope->left);
+    free_value(&rope->right);
+    if (rope->flat)
+        obj_decref(&rope->flat->obj);
+    slab_free(rope);
+}
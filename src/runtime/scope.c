@@ -1,83 +1,288 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "runtime/values.h"
 #include "runtime/scope.h"
+#include "runtime/reactive.h"
+#include "runtime/slab.h"
+#include "runtime/gc.h"
 #include "frontend/lexer.h"
 
-int resolve(Scope *scope, char *varname, Scope **out_scope, size_t *out_idx)
+// Segments of the per-thread stack scopes take their first slots from.
+static _Thread_local ScopeSegment *stack = NULL;
+static _Thread_local ScopeSegment *spare = NULL; // An emptied segment,kept so a frame straddling two doesn't malloc every time.
+
+static pthread_key_t stack_key; // Only there for its destructor,so a thread that exits gives its segments back.
+static pthread_once_t stack_once = PTHREAD_ONCE_INIT;
+
+static void free_stack(void *unused)
 {
-    for (size_t i = 0; i < scope->len; i++)
+    (void)unused;
+    while (stack)
     {
-        if (!strcmp(varname, scope->keys[i]))
-        {
-            *out_scope = scope;
-            *out_idx = i;
-            return 1;
-        }
+        ScopeSegment *below = stack->below;
+        free(stack);
+        stack = below;
     }
-    if (!scope->parent)
-        return 0;
-    return resolve(scope->parent, varname, out_scope, out_idx);
+    free(spare);
+    spare = NULL;
 }
 
-RuntimeVal declarevar(Scope *scope, char *varname, RuntimeVal value, int isconst)
+static void make_stack_key(void)
 {
-    for (size_t i = 0; i < scope->len; i++)
+    pthread_key_create(&stack_key, free_stack);
+}
+
+static ScopeSegment *push_frame(size_t n, size_t *base)
+{
+    if (!stack || stack->top + n > SEGMENT_SLOTS)
     {
-        if (!strcmp(scope->keys[i], varname))
+        if (!stack)
         {
-            fprintf(stderr, "Cannot redeclare already declared variable: %s\n", varname);
+            pthread_once(&stack_once, make_stack_key);
+            pthread_setspecific(stack_key, &stack);
+        }
+        ScopeSegment *seg = spare;
+        spare = NULL;
+        if (!seg)
+            seg = malloc(sizeof(ScopeSegment));
+        if (!seg)
+        {
+            fprintf(stderr, "Memory allocation error. Happened during initialization of scope\n");
             exit(EXIT_FAILURE);
         }
+        seg->below = stack;
+        seg->top = 0;
+        stack = seg;
     }
-    if (scope->len == scope->cap)
+    *base = stack->top;
+    stack->top += n;
+    return stack;
+}
+
+static void pop_frame(ScopeSegment *seg, size_t base, size_t n)
+{
+    if (seg != stack || base + n != seg->top)
+    {
+        fprintf(stderr, "Scopes must be freed in the opposite order they were made.\n");
+        exit(EXIT_FAILURE);
+    }
+    seg->top = base;
+    if (!seg->top && seg->below)
+    {
+        stack = seg->below;
+        free(spare);
+        spare = seg;
+    }
+}
+
+// Copies the first used elements out of the frame,or reallocates a heap array when used is 0.
+static void *resize(void *old, size_t elem, size_t cap, size_t used, char *varname)
+{
+    void *ptr = used ? malloc(elem * cap) : realloc(old, elem * cap);
+    if (!ptr)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during declaration of variable %s\n", varname);
+        exit(EXIT_FAILURE);
+    }
+    if (used)
+        memcpy(ptr, old, elem * used);
+    return ptr;
+}
+
+// Grows in place while the scope is the innermost frame,otherwise moves to the heap(its frame stays put until free_scope).
+static void grow(Scope *scope, char *varname)
+{
+    char **frame_keys = scope->frame->keys + scope->framebase;
+    size_t cap = scope->cap * 2;
+    if (scope->keys == frame_keys && scope->frame == stack && scope->framebase + scope->framecap == stack->top && stack->top + scope->cap <= SEGMENT_SLOTS)
+    {
+        stack->top += scope->cap;
+        scope->framecap = cap;
+    }
+    else
     {
-        scope->cap += 1024;
-        char **tmp = realloc(scope->keys, sizeof(char *) * scope->cap);
-        if (!tmp)
+        int fresh = scope->keys == frame_keys;
+        scope->keys = resize(scope->keys, sizeof(char *), cap, fresh ? scope->len : 0, varname);
+        scope->values = resize(scope->values, sizeof(RuntimeVal), cap, fresh ? scope->len : 0, varname);
+        scope->isconst = resize(scope->isconst, 1, cap, fresh ? scope->len : 0, varname);
+    }
+    scope->cap = cap;
+    if (scope->cells)
+    {
+        Cell **cells = realloc(scope->cells, sizeof(Cell *) * cap);
+        if (!cells)
         {
             fprintf(stderr, "Memory reallocation error. Happened during declaration of variable %s\n", varname);
             exit(EXIT_FAILURE);
         }
-        RuntimeVal *tmp2 = realloc(scope->values, sizeof(RuntimeVal) * scope->cap);
-        if (!tmp2)
+        for (size_t i = scope->len; i < cap; i++)
+            cells[i] = NULL;
+        scope->cells = cells;
+    }
+}
+
+static size_t hash_name(const char *s)
+{
+    size_t h = 14695981039346656037UL; // FNV-1a
+    while (*s)
+    {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static void index_insert(Scope *scope, size_t slot)
+{
+    size_t mask = scope->indexcap - 1;
+    size_t i = hash_name(scope->keys[slot]) & mask;
+    while (scope->index[i])
+        i = (i + 1) & mask;
+    scope->index[i] = slot + 1;
+}
+
+// Rebuilt at twice the size whenever it would get more than half full.
+static void reindex(Scope *scope)
+{
+    size_t cap = scope->indexcap ? scope->indexcap * 2 : 4 * FRAME_SLOTS;
+    size_t *index = calloc(cap, sizeof(size_t));
+    if (!index)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while indexing a scope of %zu variables\n", scope->len);
+        exit(EXIT_FAILURE);
+    }
+    free(scope->index);
+    scope->index = index;
+    scope->indexcap = cap;
+    for (size_t i = 0; i < scope->len; i++)
+        index_insert(scope, i);
+}
+
+size_t find_var(Scope *scope, const char *varname)
+{
+    if (!scope->index)
+    {
+        for (size_t i = 0; i < scope->len; i++)
         {
-            fprintf(stderr, "Memory reallocation error. Happened during declaration of variable %s\n", varname);
-            exit(EXIT_FAILURE);
+            if (!strcmp(varname, scope->keys[i]))
+                return i;
         }
-        scope->keys = tmp;
-        scope->values = tmp2;
+        return VAR_UNRESOLVED;
     }
-    scope->keys[scope->len] = my_str_dup(varname);
+    size_t mask = scope->indexcap - 1;
+    for (size_t i = hash_name(varname) & mask; scope->index[i]; i = (i + 1) & mask)
+    {
+        if (!strcmp(varname, scope->keys[scope->index[i] - 1]))
+            return scope->index[i] - 1;
+    }
+    return VAR_UNRESOLVED;
+}
+
+int resolve(Scope *scope, char *varname, Scope **out_scope, size_t *out_idx)
+{
+    for (; scope; scope = scope->parent)
+    {
+        size_t i = find_var(scope, varname);
+        if (i != VAR_UNRESOLVED)
+        {
+            *out_scope = scope;
+            *out_idx = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int is_constant(Scope *scope, char *varname)
+{
+    size_t i = find_var(scope, varname);
+    return i != VAR_UNRESOLVED && scope->isconst[i];
+}
+
+static RuntimeVal append(Scope *scope, char *varname, RuntimeVal value, int isconst)
+{
+    if (scope->len == scope->cap)
+        grow(scope, varname);
+    scope->keys[scope->len] = slab_strdup(varname);
     if (!scope->keys[scope->len])
     {
         fprintf(stderr, "Memory allocation error. Happened during declaration of variable %s\n", varname);
         exit(EXIT_FAILURE);
     }
-    scope->values[scope->len++] = value;
-    if (isconst)
+    scope->values[scope->len] = value;
+    scope->isconst[scope->len++] = isconst != 0;
+    if (scope->index && scope->len * 2 <= scope->indexcap)
+        index_insert(scope, scope->len - 1);
+    else if (scope->index || scope->len > FRAME_SLOTS) // Small scopes are scanned,it's faster than hashing.
+        reindex(scope);
+    return copy_value(value);
+}
+
+int is_declared(Scope *scope, const char *varname)
+{
+    for (; scope; scope = scope->forked ? scope->parent : NULL)
     {
-        if (scope->constantscap == scope->constantslen)
-        {
-            scope->constantscap += 1024;
-            char **tmp = realloc(scope->constants, sizeof(char *) * scope->constantscap);
-            if (!tmp)
-            {
-                fprintf(stderr, "Memory reallocation error. Happened during declaration of variable %s\n", varname);
-                exit(EXIT_FAILURE);
-            }
-            scope->constants = tmp;
-        }
-        scope->constants[scope->constantslen++] = my_str_dup(varname);
-        if (!scope->constants[scope->constantslen - 1])
+        if (find_var(scope, varname) != VAR_UNRESOLVED)
+            return 1;
+    }
+    return 0;
+}
+
+RuntimeVal declarevar(Scope *scope, char *varname, RuntimeVal value, int isconst)
+{
+    if (is_declared(scope, varname))
+    {
+        fprintf(stderr, "Cannot redeclare already declared variable: %s\n", varname);
+        exit(EXIT_FAILURE);
+    }
+    return append(scope, varname, value, isconst);
+}
+
+RuntimeVal declarevar_at(Scope *scope, size_t slot, char *varname, RuntimeVal value, int isconst)
+{
+    if (slot != scope->len)
+    {
+        fprintf(stderr, "Variable %s was resolved to slot %zu,but declared at %zu.\n", varname, slot, scope->len);
+        exit(EXIT_FAILURE);
+    }
+    return append(scope, varname, value, isconst);
+}
+
+static RuntimeVal read_slot(Scope *s, size_t idx)
+{
+    if (s->cells && s->cells[idx])
+    {
+        cell_refresh(s->cells[idx]);
+        cell_track_read(s, idx);
+    }
+    else if (reactive_enabled)
+    {
+        cell_track_read(s, idx);
+    }
+    return copy_value(s->values[idx]);
+}
+
+static RuntimeVal write_slot(Scope *s, size_t i, RuntimeVal value)
+{
+    if (s->cells && s->cells[i])
+    {
+        cell_force_thunks(s->cells[i]); // They must still see the old value.
+    }
+    free_value(&s->values[i]);
+    s->values[i] = value;
+    if (s->cells && s->cells[i])
+    {
+        if (s->cells[i]->expr)
         {
-            fprintf(stderr, "Memory allocation error. Happened during declaration of varible %s\n", varname);
-            exit(EXIT_FAILURE);
+            cell_detach(s->cells[i]); // Assigning replaces the formula.
         }
+        cell_invalidate(s->cells[i]);
     }
-
     return copy_value(value);
 }
 
@@ -90,7 +295,7 @@ RuntimeVal getvar(Scope *scope, char *varname)
         fprintf(stderr, "Cannot resolve variable %s\n", varname);
         exit(EXIT_FAILURE);
     }
-    return copy_value(s->values[idx]);
+    return read_slot(s, idx);
 }
 
 RuntimeVal setvar(Scope *scope, char *varname, RuntimeVal value)
@@ -102,43 +307,269 @@ RuntimeVal setvar(Scope *scope, char *varname, RuntimeVal value)
         fprintf(stderr,"Cannot resolve variable %s\n",varname);
         exit(EXIT_FAILURE);
     }
+    if (s->frozen)
+        s = shadowed(scope, s, &i, 1);
+
+    if (s->isconst[i])
+    {
+        fprintf(stderr, "Reassignment to constant variable %s\n", varname);
+        exit(EXIT_FAILURE);
+    }
+    return write_slot(s, i, value);
+}
+
+Scope *locate(Scope *scope, Identifier *var, size_t *out_idx)
+{
+    Scope *s = scope;
+    if (var->slot != VAR_UNRESOLVED)
+    {
+        for (size_t d = 0; d < var->depth; d++)
+            s = s->parent;
+        *out_idx = var->slot;
+    }
+    else if (!resolve(scope, var->symbol, &s, out_idx))
+    {
+        fprintf(stderr, "Cannot resolve variable %s\n", var->symbol);
+        exit(EXIT_FAILURE);
+    }
+    return s->frozen ? shadowed(scope, s, out_idx, 0) : s;
+}
+
+Scope *locate_write(Scope *scope, Identifier *var, size_t *out_idx)
+{
+    Scope *s = locate(scope, var, out_idx);
+    return s->frozen ? shadowed(scope, s, out_idx, 1) : s;
+}
+
+RuntimeVal getvar_id(Scope *scope, Identifier *var)
+{
+    size_t idx;
+    Scope *s = locate(scope, var, &idx);
+    return read_slot(s, idx);
+}
+
+RuntimeVal setvar_id(Scope *scope, Identifier *var, RuntimeVal value)
+{
+    size_t idx;
+    Scope *s = locate_write(scope, var, &idx);
+    if (var->slot == VAR_UNRESOLVED && s->isconst[idx])
+    {
+        fprintf(stderr, "Reassignment to constant variable %s\n", var->symbol);
+        exit(EXIT_FAILURE);
+    }
+    return write_slot(s, idx, value);
+}
+
+/* ---------- frozen scopes ---------- */
+
+struct Shadow
+{
+    Scope *from; // NULL for an empty entry.
+    size_t slot;
+    size_t local;
+};
+
+static size_t shadow_hash(Scope *from, size_t slot)
+{
+    return ((uintptr_t)from >> 4) ^ (slot * 0x9E3779B97F4A7C15ULL);
+}
+
+static struct Shadow *shadow_entry(Scope *fork, Scope *from, size_t slot) // The entry for it,or the empty one it would go in.
+{
+    size_t mask = fork->shadowscap - 1;
+    size_t i = shadow_hash(from, slot) & mask;
+    while (fork->shadows[i].from && (fork->shadows[i].from != from || fork->shadows[i].slot != slot))
+        i = (i + 1) & mask;
+    return &fork->shadows[i];
+}
+
+static void shadows_grow(Scope *fork)
+{
+    struct Shadow *old = fork->shadows;
+    size_t oldcap = fork->shadowscap;
+    fork->shadowscap = oldcap ? oldcap * 2 : 16;
+    fork->shadows = calloc(fork->shadowscap, sizeof(struct Shadow));
+    if (!fork->shadows)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while copying a variable out of a frozen scope.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < oldcap; i++)
+    {
+        if (old[i].from)
+            *shadow_entry(fork, old[i].from, old[i].slot) = old[i];
+    }
+    free(old);
+}
 
-    for (size_t idx = 0; idx < s->constantslen; idx++)
+Scope *shadowed(Scope *scope, Scope *frozen, size_t *idx, int create)
+{
+    Scope *fork = NULL;
+    for (Scope *s = scope; s != frozen; s = s->parent)
+    {
+        if (!s->frozen)
+            fork = s; // The last one below frozen.
+    }
+    if (!fork)
     {
-        if (!strcmp(s->constants[idx], varname))
+        if (!create)
+            return frozen;
+        fprintf(stderr, "Cannot assign to %s,its scope is frozen.\n", frozen->keys[*idx]);
+        exit(EXIT_FAILURE);
+    }
+    if (fork->shadowslen)
+    {
+        struct Shadow *e = shadow_entry(fork, frozen, *idx);
+        if (e->from)
         {
-            fprintf(stderr, "Reassignment to constant variable %s\n", varname);
-            exit(EXIT_FAILURE);
+            *idx = e->local;
+            return fork;
         }
     }
-    s->values[i] = value;
-    return copy_value(value);
+    if (!create)
+        return frozen;
+    if ((fork->shadowslen + 1) * 2 > fork->shadowscap)
+        shadows_grow(fork);
+    // Same name,so lookups by name in the fork find the copy first.
+    size_t local = fork->len;
+    RuntimeVal ret = append(fork, frozen->keys[*idx], copy_value(frozen->values[*idx]), frozen->isconst[*idx]);
+    free_value(&ret);
+    *shadow_entry(fork, frozen, *idx) = (struct Shadow){frozen, *idx, local};
+    fork->shadowslen++;
+    *idx = local;
+    return fork;
 }
 
-void init_scope(Scope *scope)
+static void *heap_copy(const void *src, size_t size)
 {
-    scope->cap = 1024;
-    scope->constantscap = 1024;
-    scope->len = 0;
-    scope->constantslen = 0;
-    scope->keys = malloc(sizeof(char *) * scope->cap);
-    if (!scope->keys)
+    void *dst = malloc(size ? size : 1);
+    if (!dst)
     {
-        fprintf(stderr, "Memory allocation error. Happened during initialization of scope\n");
+        fprintf(stderr, "Memory allocation error. Happened while freezing a scope.\n");
         exit(EXIT_FAILURE);
     }
-    scope->values = malloc(sizeof(RuntimeVal) * scope->cap);
-    if (!scope->values)
+    memcpy(dst, src, size);
+    return dst;
+}
+
+Scope *freeze_scope(Scope *scope)
+{
+    if (scope->cells)
     {
-        fprintf(stderr, "Memory allocation error. Happened during initialization of scope\n");
+        fprintf(stderr, "Cannot freeze a scope with reactive or lazy bindings.\n");
         exit(EXIT_FAILURE);
     }
-    scope->constants = malloc(sizeof(char *) * scope->constantscap);
-    if (!scope->constants)
+    if (scope->parent && !scope->parent->frozen)
     {
-        fprintf(stderr, "Memory allocation error. Happened during initialization of scope\n");
+        fprintf(stderr, "Only a scope whose parent is frozen can be frozen.\n");
         exit(EXIT_FAILURE);
     }
+    Scope *frozen = heap_copy(scope, sizeof(Scope));
+    if (scope->keys == scope->frame->keys + scope->framebase)
+    {
+        frozen->keys = heap_copy(scope->keys, sizeof(char *) * scope->len);
+        frozen->values = heap_copy(scope->values, sizeof(RuntimeVal) * scope->len);
+        frozen->isconst = heap_copy(scope->isconst, scope->len);
+        frozen->cap = scope->len;
+    }
+    pop_frame(scope->frame, scope->framebase, scope->framecap);
+    frozen->frame = NULL;
+    frozen->frozen = 1;
+    frozen->refcount = 1;
+    return frozen;
+}
+
+Scope fork_scope(Scope *frozen)
+{
+    Scope ret = new_scope(frozen);
+    ret.forked = 1;
+    __atomic_add_fetch(&frozen->refcount, 1, __ATOMIC_RELAXED);
+    return ret;
+}
+
+Scope *freeze_mapped(char **keys, RuntimeVal *values, unsigned char *isconst, size_t len, void *mapping, size_t mapsize)
+{
+    Scope *frozen = calloc(1, sizeof(Scope));
+    if (!frozen)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while freezing a scope.\n");
+        exit(EXIT_FAILURE);
+    }
+    frozen->keys = keys;
+    frozen->values = values;
+    frozen->isconst = isconst;
+    frozen->len = len;
+    frozen->cap = len;
+    frozen->frozen = 1;
+    frozen->refcount = 1;
+    frozen->mapping = mapping;
+    frozen->mapsize = mapsize;
+    if (len > FRAME_SLOTS)
+    {
+        frozen->indexcap = 2 * FRAME_SLOTS; // reindex doubles it.
+        while (frozen->indexcap < len)
+            frozen->indexcap *= 2;
+        reindex(frozen);
+    }
+    return frozen;
+}
+
+static void free_slots(Scope *scope)
+{
+    for (size_t i = 0; i < scope->len; i++)
+    {
+        slab_free(scope->keys[i]);
+        free_value(&scope->values[i]);
+    }
+    free(scope->index);
+    free(scope->shadows);
+}
+
+void release_scope(Scope *frozen)
+{
+    while (frozen && !__atomic_sub_fetch(&frozen->refcount, 1, __ATOMIC_ACQ_REL))
+    {
+        Scope *parent = frozen->forked ? frozen->parent : NULL;
+        if (frozen->mapping)
+        {
+            // The objects in the file are never freed,but something queued for freeing may still point into it.
+            gc_drain();
+            munmap(frozen->mapping, frozen->mapsize);
+            free(frozen->index);
+            free(frozen->shadows);
+            free(frozen);
+            frozen = parent;
+            continue;
+        }
+        free_slots(frozen);
+        free(frozen->keys);
+        free(frozen->values);
+        free(frozen->isconst);
+        free(frozen);
+        frozen = parent;
+    }
+}
+
+void init_scope(Scope *scope)
+{
+    scope->frame = push_frame(FRAME_SLOTS, &scope->framebase);
+    scope->keys = scope->frame->keys + scope->framebase;
+    scope->values = scope->frame->values + scope->framebase;
+    scope->isconst = scope->frame->isconst + scope->framebase;
+    scope->index = NULL;
+    scope->indexcap = 0;
+    scope->cap = FRAME_SLOTS;
+    scope->framecap = FRAME_SLOTS;
+    scope->len = 0;
+    scope->cells = NULL;
+    scope->frozen = 0;
+    scope->forked = 0;
+    scope->refcount = 0;
+    scope->shadows = NULL;
+    scope->shadowslen = 0;
+    scope->shadowscap = 0;
+    scope->mapping = NULL;
+    scope->mapsize = 0;
 }
 
 Scope new_scope(Scope *parent)
@@ -160,15 +591,22 @@ void init_global_scope(Scope *scope)
 
 void free_scope(Scope *scope)
 {
-    for (size_t i = 0; i < scope->len; i++)
+    free_slots(scope);
+    if (scope->keys != scope->frame->keys + scope->framebase)
     {
-        free(scope->keys[i]);
+        free(scope->keys); // Outgrew its frame.
+        free(scope->values);
+        free(scope->isconst);
     }
-    free(scope->keys);
-    free(scope->values);
-    for (size_t i = 0; i < scope->constantslen; i++)
+    pop_frame(scope->frame, scope->framebase, scope->framecap);
+    if (scope->cells)
     {
-        free(scope->constants[i]);
+        for (size_t i = 0; i < scope->len; i++)
+        {
+            free_cell(scope->cells[i]);
+        }
+        free(scope->cells);
     }
-    free(scope->constants);
+    if (scope->forked)
+        release_scope(scope->parent);
 }
\ No newline at end of file
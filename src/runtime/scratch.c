@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "runtime/scratch.h"
+
+typedef struct
+{
+    char *base;
+    size_t cap;
+} Block;
+
+// Blocks past current are spare,kept for the next time the region grows that far.
+static _Thread_local Block *blocks = NULL;
+static _Thread_local size_t nblocks = 0, blockcap = 0;
+static _Thread_local size_t current = 0, used = 0;
+
+static pthread_key_t blocks_key; // For its destructor,a thread that exits frees its blocks.
+static pthread_once_t blocks_once = PTHREAD_ONCE_INIT;
+
+static void free_blocks(void *unused)
+{
+    (void)unused;
+    for (size_t i = 0; i < nblocks; i++)
+        free(blocks[i].base);
+    free(blocks);
+    blocks = NULL;
+    nblocks = blockcap = current = used = 0;
+}
+
+static void make_blocks_key(void)
+{
+    pthread_key_create(&blocks_key, free_blocks);
+}
+
+void *scratch_alloc(size_t size)
+{
+    if (size > SIZE_MAX - 15)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while allocating %zu bytes of scratch memory.\n", size);
+        exit(EXIT_FAILURE);
+    }
+    size = size ? (size + 15) & ~(size_t)15 : 16; // Never NULL,even for nothing.
+    if (nblocks && size <= blocks[current].cap - used)
+    {
+        void *ptr = blocks[current].base + used;
+        used += size;
+        return ptr;
+    }
+    size_t next = nblocks ? current + 1 : 0;
+    if (next == nblocks)
+    {
+        if (!blocks)
+        {
+            pthread_once(&blocks_once, make_blocks_key);
+            pthread_setspecific(blocks_key, &blocks);
+        }
+        if (nblocks == blockcap)
+        {
+            size_t cap = blockcap ? blockcap * 2 : 8;
+            Block *tmp = realloc(blocks, sizeof(Block) * cap);
+            if (!tmp)
+            {
+                fprintf(stderr, "Memory reallocation error. Happened while growing scratch memory.\n");
+                exit(EXIT_FAILURE);
+            }
+            blocks = tmp;
+            blockcap = cap;
+        }
+        blocks[nblocks++] = (Block){NULL, 0};
+    }
+    if (blocks[next].cap < size)
+    {
+        size_t cap = size > SCRATCH_BLOCK ? size : SCRATCH_BLOCK;
+        free(blocks[next].base);
+        blocks[next].base = malloc(cap);
+        if (!blocks[next].base)
+        {
+            fprintf(stderr, "Memory allocation error. Happened while allocating %zu bytes of scratch memory.\n", size);
+            exit(EXIT_FAILURE);
+        }
+        blocks[next].cap = cap;
+    }
+    current = next;
+    used = size;
+    return blocks[next].base;
+}
+
+ScratchMark scratch_mark(void)
+{
+    return (ScratchMark){current, used};
+}
+
+void scratch_release(ScratchMark mark)
+{
+    current = mark.block;
+    used = mark.used;
+}
+
+void scratch_reset(void)
+{
+    size_t keep = nblocks && blocks[0].cap <= SCRATCH_BLOCK;
+    for (size_t i = keep; i < nblocks; i++)
+        free(blocks[i].base);
+    nblocks = keep;
+    current = 0;
+    used = 0;
+    if (!keep)
+    {
+        free(blocks);
+        blocks = NULL;
+        blockcap = 0;
+    }
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "runtime/slab.h"
+
+char *slab_strdup(const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = slab_alloc(len);
+    if (copy)
+        memcpy(copy, str, len);
+    return copy;
+}
+
+#ifndef VALEX_NO_SLAB
+#define HEADER sizeof(uint64_t) // The size class,in front of every block.
+#define CLASSES 13
+#define LARGE CLASSES // The class of a block that came from malloc.
+#define CHUNK (64 * 1024)
+
+// Two classes per power of two,so at most a third of a block is wasted.Sizes include the header.
+static const size_t class_size[CLASSES] = {16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+
+typedef struct Block
+{
+    struct Block *next;
+    struct Block *next_batch; // Only set on the first block of a batch in the global pool.
+} Block; // A free block,laid over its header.
+
+typedef struct
+{
+    Block *head;
+    size_t count;
+} FreeList;
+
+static _Thread_local FreeList cache[CLASSES];
+static _Thread_local int tracked; // cache_key is set for this thread,so its cache is given back when it exits.
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static Block *pool[CLASSES]; // Stacks of SLAB_BATCH long lists.
+static FreeList leftover[CLASSES]; // Fewer than SLAB_BATCH blocks from exited threads,under pool_lock.
+static pthread_key_t cache_key; // Only there for its destructor.
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static void *chunks = NULL; // Every chunk,linked through its first word,so they stay reachable.
+
+static size_t class_of(size_t total)
+{
+    if (total <= 16)
+        return 0;
+    size_t k = 63 - (size_t)__builtin_clzll((unsigned long long)(total - 1)); // 2^k < total <= 2^(k+1).
+    return 2 * (k - 4) + 1 + (total > ((size_t)3 << (k - 1)));
+}
+
+static void push_batch(Block *batch, size_t c) // pool_lock is held.
+{
+    batch->next_batch = pool[c];
+    pool[c] = batch;
+}
+
+// A thread that exits puts every block it holds back in the pool,in whole batches,and keeps the rest
+// in leftover until enough come together.
+static void flush_cache(void *unused)
+{
+    (void)unused;
+    pthread_mutex_lock(&pool_lock);
+    for (size_t c = 0; c < CLASSES; c++)
+    {
+        FreeList *list = &cache[c];
+        while (list->head)
+        {
+            Block *block = list->head;
+            list->head = block->next;
+            block->next = leftover[c].head;
+            leftover[c].head = block;
+            if (++leftover[c].count == SLAB_BATCH)
+            {
+                push_batch(leftover[c].head, c);
+                leftover[c].head = NULL;
+                leftover[c].count = 0;
+            }
+        }
+        list->count = 0;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    tracked = 0;
+}
+
+static void make_cache_key(void)
+{
+    pthread_key_create(&cache_key, flush_cache);
+}
+
+static void track(void)
+{
+    tracked = 1;
+    pthread_once(&cache_once, make_cache_key);
+    pthread_setspecific(cache_key, cache);
+}
+
+static int refill(size_t c)
+{
+    FreeList *list = &cache[c];
+    if (!tracked)
+        track();
+    pthread_mutex_lock(&pool_lock);
+    Block *batch = pool[c];
+    if (batch)
+        pool[c] = batch->next_batch;
+    pthread_mutex_unlock(&pool_lock);
+    if (batch)
+    {
+        list->head = batch;
+        list->count = SLAB_BATCH;
+        return 1;
+    }
+    char *chunk = malloc(CHUNK);
+    if (!chunk)
+        return 0;
+    pthread_mutex_lock(&pool_lock);
+    *(void **)chunk = chunks;
+    chunks = chunk;
+    pthread_mutex_unlock(&pool_lock);
+    size_t size = class_size[c];
+    for (size_t at = 16; at + size <= CHUNK; at += size) // The first 16 bytes link the chunk into chunks.
+    {
+        Block *block = (Block *)(chunk + at);
+        block->next = list->head;
+        list->head = block;
+        list->count++;
+    }
+    return 1;
+}
+
+static void spill(size_t c) // Hands the most recently freed SLAB_BATCH blocks to the global pool.
+{
+    FreeList *list = &cache[c];
+    Block *batch = list->head, *last = batch;
+    for (size_t i = 1; i < SLAB_BATCH; i++)
+        last = last->next;
+    list->head = last->next;
+    list->count -= SLAB_BATCH;
+    last->next = NULL;
+    pthread_mutex_lock(&pool_lock);
+    push_batch(batch, c);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void *slab_alloc(size_t size)
+{
+    if (size > SLAB_MAX)
+    {
+        if (size > SIZE_MAX - HEADER)
+            return NULL;
+        uint64_t *block = malloc(HEADER + size);
+        if (!block)
+            return NULL;
+        *block = LARGE;
+        return block + 1;
+    }
+    size_t c = class_of(HEADER + size);
+    FreeList *list = &cache[c];
+    if (!list->head && !refill(c))
+        return NULL;
+    Block *block = list->head;
+    list->head = block->next;
+    list->count--;
+    *(uint64_t *)block = c;
+    return (uint64_t *)block + 1;
+}
+
+void slab_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    uint64_t *header = (uint64_t *)ptr - 1;
+    size_t c = (size_t)*header;
+    if (c == LARGE)
+    {
+        free(header);
+        return;
+    }
+    FreeList *list = &cache[c];
+    if (!tracked)
+        track(); // A thread can free blocks it never allocated,a pool thread dropping temporaries.
+    Block *block = (Block *)header;
+    block->next = list->head;
+    list->head = block;
+    if (++list->count >= 2 * SLAB_BATCH)
+        spill(c);
+}
+
+void *slab_realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        return slab_alloc(size);
+    uint64_t *header = (uint64_t *)ptr - 1;
+    size_t c = (size_t)*header;
+    if (c == LARGE && size > SLAB_MAX)
+    {
+        if (size > SIZE_MAX - HEADER)
+            return NULL;
+        uint64_t *block = realloc(header, HEADER + size);
+        return block ? block + 1 : NULL;
+    }
+    if (c != LARGE && size <= class_size[c] - HEADER)
+        return ptr; // Still fits its block.
+    void *fresh = slab_alloc(size);
+    if (!fresh)
+        return NULL;
+    memcpy(fresh, ptr, c == LARGE ? size : class_size[c] - HEADER); // Shrinking out of a large block,or growing out of a small one.
+    slab_free(ptr);
+    return fresh;
+}
+#endif
@@ -0,0 +1,427 @@
+#define _POSIX_C_SOURCE 200809L // For fstat and mmap.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "runtime/values.h"
+#include "runtime/scope.h"
+#include "runtime/bigint.h"
+#include "runtime/array.h"
+#include "runtime/map.h"
+#include "runtime/record.h"
+#include "runtime/snapshot.h"
+
+#define SNAPSHOT_MAGIC "VALEXSNP"
+#define SNAPSHOT_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t wordsize; // sizeof(void *) where it was written.
+    uint64_t size; // Of the whole file.
+    uint64_t len; // Variables.
+    uint64_t keys; // Offsets of char *[len],RuntimeVal[len] and unsigned char[len].
+    uint64_t values;
+    uint64_t isconst;
+    uint64_t relocs; // Offset of uint64_t[nrelocs],the offsets of the words holding a pointer.
+    uint64_t nrelocs;
+    uint64_t shapes; // Offset of uint64_t[nshapes],the offsets of records' shape fields.
+    uint64_t nshapes;
+} Header;
+
+// What a record's shape field points to in the file.
+typedef struct
+{
+    Shape *resolved; // NULL until the first record with it is read.
+    uint64_t nfields;
+    char *names[]; // In slot order.
+} ShapeDesc;
+
+/* ---------- writing ---------- */
+
+typedef struct
+{
+    const void *obj; // NULL for an empty entry.
+    uint64_t at;
+} Seen;
+
+typedef struct
+{
+    char *buf; // The file,built in memory.
+    size_t len;
+    size_t cap;
+    uint64_t *relocs;
+    size_t nrelocs;
+    size_t reloccap;
+    uint64_t *shapes;
+    size_t nshapes;
+    size_t shapecap;
+    Seen *seen; // Objects and shapes already written,so what's shared in the scope is shared in the file.
+    size_t seenlen;
+    size_t seencap;
+    uint64_t *pending; // Maps and records whose entries aren't written yet,an explicit stack so depth doesn't matter.
+    size_t npending;
+    size_t pendingcap;
+} Writer;
+
+#define AT(w, off, type) ((type *)((w)->buf + (off))) // Only until the next emit,which may move buf.
+
+static void *reserve(void *items, size_t *cap, size_t len, size_t size)
+{
+    if (len < *cap)
+        return items;
+    *cap = *cap ? *cap * 2 : 64;
+    void *tmp = realloc(items, *cap * size);
+    if (!tmp)
+    {
+        fprintf(stderr, "Memory reallocation error. Happened while writing a snapshot.\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+static uint64_t emit(Writer *w, size_t size, size_t align) // Offset of size zeroed bytes.
+{
+    size_t at = (w->len + align - 1) / align * align;
+    if (at + size > w->cap)
+    {
+        size_t cap = w->cap ? w->cap : 4096;
+        while (cap < at + size)
+            cap *= 2;
+        char *tmp = realloc(w->buf, cap);
+        if (!tmp)
+        {
+            fprintf(stderr, "Memory reallocation error. Happened while writing a snapshot.\n");
+            exit(EXIT_FAILURE);
+        }
+        w->buf = tmp;
+        w->cap = cap;
+    }
+    memset(w->buf + w->len, 0, at + size - w->len);
+    w->len = at + size;
+    return at;
+}
+
+static void put_pointer(Writer *w, uint64_t at, uint64_t to) // The word at at points to offset to.
+{
+    *AT(w, at, uint64_t) = SNAPSHOT_BASE + to;
+    w->relocs = reserve(w->relocs, &w->reloccap, w->nrelocs, sizeof(uint64_t));
+    w->relocs[w->nrelocs++] = at;
+}
+
+static Seen *seen_entry(Writer *w, const void *obj) // Its entry,or the empty one it would go in.
+{
+    size_t mask = w->seencap - 1;
+    size_t i = ((uintptr_t)obj >> 3) * 0x9E3779B97F4A7C15ULL & mask;
+    while (w->seen[i].obj && w->seen[i].obj != obj)
+        i = (i + 1) & mask;
+    return &w->seen[i];
+}
+
+static void seen_add(Writer *w, const void *obj, uint64_t at)
+{
+    if ((w->seenlen + 1) * 2 > w->seencap)
+    {
+        Seen *old = w->seen;
+        size_t oldcap = w->seencap;
+        w->seencap = oldcap ? oldcap * 2 : 64;
+        w->seen = calloc(w->seencap, sizeof(Seen));
+        if (!w->seen)
+        {
+            fprintf(stderr, "Memory allocation error. Happened while writing a snapshot.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < oldcap; i++)
+        {
+            if (old[i].obj)
+                *seen_entry(w, old[i].obj) = old[i];
+        }
+        free(old);
+    }
+    *seen_entry(w, obj) = (Seen){obj, at};
+    w->seenlen++;
+}
+
+static uint64_t seen_find(Writer *w, const void *obj) // 0 when it isn't written yet,the header is at 0.
+{
+    return w->seenlen ? seen_entry(w, obj)->at : 0;
+}
+
+static uint64_t write_chars(Writer *w, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    uint64_t at = emit(w, size, 1);
+    memcpy(AT(w, at, char), str, size);
+    return at;
+}
+
+static uint64_t write_shape(Writer *w, const Shape *shape)
+{
+    uint64_t at = seen_find(w, shape);
+    if (at)
+        return at;
+    at = emit(w, sizeof(ShapeDesc) + sizeof(char *) * shape->nfields, 8);
+    AT(w, at, ShapeDesc)->nfields = shape->nfields;
+    for (size_t i = 0; i < shape->nfields; i++)
+        put_pointer(w, at + offsetof(ShapeDesc, names) + sizeof(char *) * i, write_chars(w, shape->names[i]));
+    seen_add(w, shape, at);
+    return at;
+}
+
+// The object v points to,with its pointers still to be filled in for maps and records.
+static uint64_t write_obj(Writer *w, RuntimeVal v)
+{
+    Obj *obj = VAL_AS_OBJ(v);
+    uint64_t at;
+    switch (obj->kind)
+    {
+    case OBJ_String:
+    case OBJ_Rope:
+    case OBJ_Slice:
+    {
+        StringVal view = VAL_AS_STRING(&v);
+        at = emit(w, sizeof(StringObj) + view.length + 1, 8);
+        StringObj *str = AT(w, at, StringObj);
+        str->obj.kind = OBJ_String;
+        str->length = view.length;
+        str->capacity = view.length;
+        str->hash = view.obj ? string_hash(view.obj) : 0;
+        memcpy(str->chars, view.chars, view.length);
+        break;
+    }
+    case OBJ_Integer:
+        at = emit(w, sizeof(IntegerObj), 8);
+        *AT(w, at, IntegerObj) = *(IntegerObj *)obj;
+        break;
+    case OBJ_BigInt:
+    {
+        size_t size = sizeof(BigIntObj) + sizeof(uint64_t) * ((BigIntObj *)obj)->length;
+        at = emit(w, size, 8);
+        memcpy(AT(w, at, char), obj, size);
+        break;
+    }
+    case OBJ_Array:
+    {
+        ArrayObj *arr = (ArrayObj *)obj;
+        at = emit(w, sizeof(ArrayObj), 8);
+        uint64_t data = emit(w, sizeof(double) * (arr->length ? arr->length : 1), ARRAY_ALIGN);
+        memcpy(AT(w, data, double), arr->data, sizeof(double) * arr->length);
+        AT(w, at, ArrayObj)->length = arr->length;
+        put_pointer(w, at + offsetof(ArrayObj, data), data);
+        break;
+    }
+    case OBJ_Map:
+    {
+        MapObj *map = (MapObj *)obj;
+        at = emit(w, sizeof(MapObj), 8);
+        uint64_t ctrl = emit(w, map->capacity + MAP_GROUP_WIDTH, 1);
+        memcpy(AT(w, ctrl, uint8_t), map->ctrl, map->capacity + MAP_GROUP_WIDTH);
+        uint64_t slots = emit(w, sizeof(MapSlot) * map->capacity, 8);
+        AT(w, at, MapObj)->length = map->length;
+        AT(w, at, MapObj)->capacity = map->capacity;
+        put_pointer(w, at + offsetof(MapObj, ctrl), ctrl);
+        put_pointer(w, at + offsetof(MapObj, slots), slots);
+        break;
+    }
+    case OBJ_Record:
+    {
+        RecordObj *rec = (RecordObj *)obj;
+        at = emit(w, sizeof(RecordObj), 8);
+        uint64_t slots = emit(w, sizeof(RuntimeVal) * (rec->shape->nfields ? rec->shape->nfields : 1), 8);
+        uint64_t shape = write_shape(w, rec->shape);
+        AT(w, at, RecordObj)->capacity = rec->shape->nfields;
+        put_pointer(w, at + offsetof(RecordObj, slots), slots);
+        put_pointer(w, at + offsetof(RecordObj, shape), shape);
+        w->shapes = reserve(w->shapes, &w->shapecap, w->nshapes, sizeof(uint64_t));
+        w->shapes[w->nshapes++] = at + offsetof(RecordObj, shape);
+        break;
+    }
+    default:
+        fprintf(stderr, "Exhaustive handling of ObjType in write_obj.\n");
+        exit(EXIT_FAILURE);
+    }
+    AT(w, at, Obj)->refcount = SNAPSHOT_REFCOUNT;
+    AT(w, at, Obj)->kind = obj->kind == OBJ_Rope || obj->kind == OBJ_Slice ? OBJ_String : obj->kind;
+    if (obj->kind == OBJ_Map || obj->kind == OBJ_Record)
+    {
+        w->pending = reserve(w->pending, &w->pendingcap, w->npending, sizeof(uint64_t) * 2);
+        w->pending[w->npending++] = (uint64_t)(uintptr_t)obj;
+        w->pending[w->npending++] = at;
+    }
+    return at;
+}
+
+static void put_value(Writer *w, uint64_t at, RuntimeVal v)
+{
+    if (!VAL_IS_OBJ(v) && !VAL_IS_HEAP_STRING(v))
+    {
+        *AT(w, at, RuntimeVal) = v;
+        return;
+    }
+    uint64_t obj = seen_find(w, VAL_AS_OBJ(v));
+    if (!obj)
+    {
+        obj = write_obj(w, v);
+        seen_add(w, VAL_AS_OBJ(v), obj);
+    }
+    put_pointer(w, at, obj);
+    *AT(w, at, uint64_t) |= VAL_TAG(v);
+}
+
+static void put_entries(Writer *w, Obj *obj, uint64_t at) // Of a map or record write_obj wrote at at.
+{
+    if (obj->kind == OBJ_Map)
+    {
+        MapObj *map = (MapObj *)obj;
+        uint64_t slots = *AT(w, at + offsetof(MapObj, slots), uint64_t) - SNAPSHOT_BASE;
+        for (size_t i = 0; i < map->capacity; i++)
+        {
+            if (map->ctrl[i] == MAP_EMPTY)
+                continue;
+            put_value(w, slots + sizeof(MapSlot) * i + offsetof(MapSlot, key), map->slots[i].key);
+            put_value(w, slots + sizeof(MapSlot) * i + offsetof(MapSlot, value), map->slots[i].value);
+        }
+        return;
+    }
+    RecordObj *rec = (RecordObj *)obj;
+    uint64_t slots = *AT(w, at + offsetof(RecordObj, slots), uint64_t) - SNAPSHOT_BASE;
+    for (size_t i = 0; i < rec->shape->nfields; i++)
+        put_value(w, slots + sizeof(RuntimeVal) * i, rec->slots[i]);
+}
+
+static uint64_t write_table(Writer *w, const uint64_t *items, size_t n)
+{
+    uint64_t at = emit(w, sizeof(uint64_t) * n, 8);
+    if (n)
+        memcpy(AT(w, at, uint64_t), items, sizeof(uint64_t) * n);
+    return at;
+}
+
+void snapshot_write(Scope *scope, const char *path)
+{
+    if (scope->cells)
+    {
+        fprintf(stderr, "Cannot snapshot a scope with reactive or lazy bindings.\n");
+        exit(EXIT_FAILURE);
+    }
+    Writer w = {0};
+    emit(&w, sizeof(Header), 8);
+    uint64_t keys = emit(&w, sizeof(char *) * scope->len, 8);
+    uint64_t values = emit(&w, sizeof(RuntimeVal) * scope->len, 8);
+    uint64_t isconst = emit(&w, scope->len, 1);
+    for (size_t i = 0; i < scope->len; i++)
+    {
+        put_pointer(&w, keys + sizeof(char *) * i, write_chars(&w, scope->keys[i]));
+        put_value(&w, values + sizeof(RuntimeVal) * i, scope->values[i]);
+        AT(&w, isconst, unsigned char)[i] = scope->isconst[i];
+        while (w.npending)
+        {
+            uint64_t at = w.pending[--w.npending];
+            Obj *obj = (Obj *)(uintptr_t)w.pending[--w.npending];
+            put_entries(&w, obj, at);
+        }
+    }
+    uint64_t relocs = write_table(&w, w.relocs, w.nrelocs);
+    uint64_t shapes = write_table(&w, w.shapes, w.nshapes);
+
+    Header *h = AT(&w, 0, Header);
+    memcpy(h->magic, SNAPSHOT_MAGIC, sizeof h->magic);
+    h->version = SNAPSHOT_VERSION;
+    h->wordsize = sizeof(void *);
+    h->size = w.len;
+    h->len = scope->len;
+    h->keys = keys;
+    h->values = values;
+    h->isconst = isconst;
+    h->relocs = relocs;
+    h->nrelocs = w.nrelocs;
+    h->shapes = shapes;
+    h->nshapes = w.nshapes;
+
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(w.buf, 1, w.len, f) != w.len || fclose(f))
+    {
+        fprintf(stderr, "Could not write snapshot %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    free(w.buf);
+    free(w.relocs);
+    free(w.shapes);
+    free(w.seen);
+    free(w.pending);
+}
+
+/* ---------- reading ---------- */
+
+static int in_file(const Header *h, uint64_t at, uint64_t count, uint64_t size) // count items of size fit at at.
+{
+    return at <= h->size && count <= (h->size - at) / size;
+}
+
+static void corrupt(const char *path)
+{
+    fprintf(stderr, "%s is not a snapshot written by this build of valex.\n", path);
+    exit(EXIT_FAILURE);
+}
+
+Scope *snapshot_read(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st))
+    {
+        fprintf(stderr, "Could not open snapshot %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < sizeof(Header))
+        corrupt(path);
+    // Private,so what's written(relocation,refcounts,cached hashes) stays in this process.
+    char *base = mmap((void *)(uintptr_t)SNAPSHOT_BASE, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map snapshot %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    Header *h = (Header *)base;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof h->magic) || h->version != SNAPSHOT_VERSION ||
+        h->wordsize != sizeof(void *) || h->size != size || !in_file(h, h->keys, h->len, sizeof(char *)) ||
+        !in_file(h, h->values, h->len, sizeof(RuntimeVal)) || !in_file(h, h->isconst, h->len, 1) ||
+        !in_file(h, h->relocs, h->nrelocs, sizeof(uint64_t)) || !in_file(h, h->shapes, h->nshapes, sizeof(uint64_t)))
+        corrupt(path);
+
+    // Only needed when the address was taken,wrapping arithmetic moves pointers either way.
+    uint64_t delta = (uint64_t)(uintptr_t)base - SNAPSHOT_BASE;
+    const uint64_t *relocs = (const uint64_t *)(base + h->relocs);
+    for (size_t i = 0; delta && i < h->nrelocs; i++)
+    {
+        if (relocs[i] % 8 || !in_file(h, relocs[i], 1, sizeof(uint64_t)))
+            corrupt(path);
+        *(uint64_t *)(base + relocs[i]) += delta;
+    }
+    const uint64_t *shapes = (const uint64_t *)(base + h->shapes);
+    for (size_t i = 0; i < h->nshapes; i++)
+    {
+        if (shapes[i] % 8 || !in_file(h, shapes[i], 1, sizeof(Shape *)))
+            corrupt(path);
+        Shape **field = (Shape **)(base + shapes[i]);
+        ShapeDesc *desc = (ShapeDesc *)*field;
+        if (!desc->resolved)
+        {
+            Shape *shape = shape_root();
+            for (size_t j = 0; j < desc->nfields; j++)
+                shape = shape_with(shape, desc->names[j]);
+            desc->resolved = shape;
+        }
+        *field = desc->resolved;
+    }
+    return freeze_mapped((char **)(base + h->keys), (RuntimeVal *)(base + h->values),
+                         (unsigned char *)(base + h->isconst), h->len, base, size);
+}
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "runtime/values.h"
+#include "runtime/map.h"
+#include "runtime/text.h"
+#include "runtime/slab.h"
+#include "runtime/scratch.h"
+
+// One block type per target,like the kernels in array.c.Targets without either only run two-way.
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i block;
+#define BLOCK_WIDTH 32
+#define block_set1(c) _mm256_set1_epi8((char)(c))
+#define block_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define block_match(a, b, x, y) ((uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, x), _mm256_cmpeq_epi8(b, y))))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i block;
+#define BLOCK_WIDTH 16
+#define block_set1(c) _mm_set1_epi8((char)(c))
+#define block_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define block_match(a, b, x, y) ((uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, x), _mm_cmpeq_epi8(b, y))))
+#endif
+
+typedef struct
+{
+    const unsigned char *x;
+    size_t m;
+    ptrdiff_t ell; // Critical factorization:x[0..ell] and x[ell+1..m).
+    ptrdiff_t per; // How far a full match shifts.
+    int periodic; // x[0..ell] repeats with period per,so a matched prefix is remembered across shifts.
+} Searcher;
+
+// The maximal suffix of x under the byte order(or the reverse one),as the position just before it,and its period.
+static ptrdiff_t max_suffix(const unsigned char *x, ptrdiff_t m, ptrdiff_t *period, int reversed)
+{
+    ptrdiff_t ms = -1, j = 0, k = 1, p = 1;
+    while (j + k < m)
+    {
+        unsigned char a = x[j + k], b = x[ms + k];
+        if (reversed ? a > b : a < b)
+        {
+            j += k;
+            k = 1;
+            p = j - ms;
+        }
+        else if (a == b)
+        {
+            if (k != p)
+            {
+                k++;
+            }
+            else
+            {
+                j += p;
+                k = 1;
+            }
+        }
+        else
+        {
+            ms = j;
+            j = ms + 1;
+            k = p = 1;
+        }
+    }
+    *period = p;
+    return ms;
+}
+
+static void searcher_init(Searcher *s, StringVal needle)
+{
+    s->x = (const unsigned char *)needle.chars;
+    s->m = needle.length;
+    s->ell = -1;
+    s->per = 1;
+    s->periodic = 0;
+    if (s->m < 2)
+        return; // Found with memchr.
+    ptrdiff_t p, q;
+    ptrdiff_t i = max_suffix(s->x, (ptrdiff_t)s->m, &p, 0);
+    ptrdiff_t j = max_suffix(s->x, (ptrdiff_t)s->m, &q, 1);
+    s->ell = i > j ? i : j;
+    s->per = i > j ? p : q;
+    s->periodic = !memcmp(s->x, s->x + s->per, (size_t)s->ell + 1);
+    if (!s->periodic)
+    {
+        ptrdiff_t right = (ptrdiff_t)s->m - s->ell - 1;
+        s->per = (s->ell + 1 > right ? s->ell + 1 : right) + 1;
+    }
+}
+
+// Crochemore-Perrin two-way:the right half is matched left to right,then the left half right to left.
+// Linear time and constant space whatever the input.
+static size_t two_way(const Searcher *s, const unsigned char *y, size_t n, size_t from)
+{
+    const unsigned char *x = s->x;
+    ptrdiff_t m = (ptrdiff_t)s->m, ell = s->ell, per = s->per;
+    ptrdiff_t j = (ptrdiff_t)from, last = (ptrdiff_t)n - m;
+    ptrdiff_t memory = -1;
+    while (j <= last)
+    {
+        ptrdiff_t i = (ell > memory ? ell : memory) + 1;
+        while (i < m && x[i] == y[i + j])
+            i++;
+        if (i < m)
+        {
+            j += i - ell;
+            memory = -1;
+            continue;
+        }
+        i = ell;
+        while (i > memory && x[i] == y[i + j])
+            i--;
+        if (i <= memory)
+            return (size_t)j;
+        j += per;
+        memory = s->periodic ? m - per - 1 : -1;
+    }
+    return TEXT_NOT_FOUND;
+}
+
+#ifdef BLOCK_WIDTH
+// Candidates are the positions where both the first and the last byte of the needle line up.
+static size_t filtered(const Searcher *s, const unsigned char *y, size_t n, size_t from)
+{
+    size_t m = s->m;
+    block first = block_set1(s->x[0]), last = block_set1(s->x[m - 1]);
+    size_t i = from, checked = 0;
+    for (; i + m - 1 + BLOCK_WIDTH <= n; i += BLOCK_WIDTH)
+    {
+        for (uint32_t hits = block_match(block_load(y + i), block_load(y + i + m - 1), first, last); hits; hits &= hits - 1)
+        {
+            size_t j = i + (size_t)__builtin_ctz(hits);
+            if (!memcmp(y + j + 1, s->x + 1, m - 2))
+                return j;
+            checked += m;
+        }
+        // Mostly false candidates means the input is degenerate,where two-way's linear bound pays off.
+        if (checked > (i + BLOCK_WIDTH - from) * 8 + 4096)
+            return two_way(s, y, n, i + BLOCK_WIDTH);
+    }
+    return two_way(s, y, n, i); // Less than a block left.
+}
+#endif
+
+static size_t search(const Searcher *s, StringVal hay, size_t from)
+{
+    const unsigned char *y = (const unsigned char *)hay.chars;
+    size_t n = hay.length;
+    if (from > n || n - from < s->m)
+        return TEXT_NOT_FOUND;
+    if (s->m == 0)
+        return from;
+    if (s->m == 1)
+    {
+        const unsigned char *hit = memchr(y + from, s->x[0], n - from);
+        return hit ? (size_t)(hit - y) : TEXT_NOT_FOUND;
+    }
+#ifdef BLOCK_WIDTH
+    return filtered(s, y, n, from);
+#else
+    return two_way(s, y, n, from);
+#endif
+}
+
+size_t text_find(StringVal hay, StringVal needle)
+{
+    Searcher s;
+    searcher_init(&s, needle);
+    return search(&s, hay, 0);
+}
+
+size_t text_count(StringVal hay, StringVal needle)
+{
+    if (!needle.length)
+        return hay.length + 1; // Once before every byte and once at the end.
+    Searcher s;
+    searcher_init(&s, needle);
+    size_t count = 0;
+    for (size_t at = search(&s, hay, 0); at != TEXT_NOT_FOUND; at = search(&s, hay, at + needle.length))
+        count++;
+    return count;
+}
+
+RuntimeVal text_split(RuntimeVal str, StringVal sep)
+{
+    if (!sep.length)
+    {
+        fprintf(stderr, "Cannot split on an empty separator.\n");
+        exit(EXIT_FAILURE);
+    }
+    StringVal view = VAL_AS_STRING(&str);
+    Searcher s;
+    searcher_init(&s, sep);
+    MapObj *pieces = map_alloc(0);
+    size_t start = 0;
+    for (int64_t k = 0;; k++)
+    {
+        size_t at = search(&s, view, start);
+        size_t end = at == TEXT_NOT_FOUND ? view.length : at;
+        map_set(pieces, runtimeval_integer(k), string_slice(str, start, end - start));
+        if (at == TEXT_NOT_FOUND)
+            break;
+        start = at + sep.length;
+    }
+    return runtimeval_map(pieces);
+}
+
+RuntimeVal text_replace(RuntimeVal str, StringVal from, StringVal to)
+{
+    if (!from.length)
+    {
+        fprintf(stderr, "Cannot replace an empty string.\n");
+        exit(EXIT_FAILURE);
+    }
+    StringVal view = VAL_AS_STRING(&str);
+    Searcher s;
+    searcher_init(&s, from);
+    size_t count = 0, cap = 0;
+    size_t *hits = NULL;
+    ScratchMark mark = scratch_mark();
+    for (size_t at = search(&s, view, 0); at != TEXT_NOT_FOUND; at = search(&s, view, at + from.length))
+    {
+        if (count == cap)
+        {
+            // The old array stays behind in scratch,which at most doubles the total.
+            cap = cap ? cap * 2 : 16;
+            size_t *tmp = scratch_alloc(sizeof(size_t) * cap);
+            if (count)
+                memcpy(tmp, hits, sizeof(size_t) * count);
+            hits = tmp;
+        }
+        hits[count++] = at;
+    }
+    if (!count)
+    {
+        scratch_release(mark);
+        return copy_value(str); // Nothing to replace,the string itself is the result.
+    }
+    if (to.length > from.length && count > (SIZE_MAX - view.length) / (to.length - from.length))
+    {
+        fprintf(stderr, "String replacement result is too long.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t total = view.length - count * from.length + count * to.length;
+
+    char small[VAL_SHORT_STRING_MAX];
+    StringObj *out = total <= VAL_SHORT_STRING_MAX ? NULL : string_alloc(total);
+    char *dst = out ? out->chars : small;
+    size_t prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        memcpy(dst, view.chars + prev, hits[i] - prev);
+        dst += hits[i] - prev;
+        memcpy(dst, to.chars, to.length);
+        dst += to.length;
+        prev = hits[i] + from.length;
+    }
+    memcpy(dst, view.chars + prev, view.length - prev);
+    scratch_release(mark);
+    return out ? runtimeval_string_obj(out) : runtimeval_string_len(small, total);
+}
+
+RuntimeVal string_slice(RuntimeVal str, size_t start, size_t length)
+{
+    StringVal view = VAL_AS_STRING(&str);
+    if (length < SLICE_MIN)
+        return runtimeval_string_len(view.chars + start, length);
+    if (start == 0 && length == view.length)
+        return copy_value(str);
+    Obj *base = VAL_AS_OBJ(str); // Never an inline string,those are shorter than SLICE_MIN.
+    if (base->kind == OBJ_Slice)
+        base = ((SliceObj *)base)->base; // A slice of a slice points straight at the bytes' owner.
+    SliceObj *slice = slab_alloc(sizeof(SliceObj));
+    if (!slice)
+    {
+        fprintf(stderr, "Memory allocation error. Happened while slicing string of length %zu.\n", view.length);
+        exit(EXIT_FAILURE);
+    }
+    obj_incref(base);
+    slice->obj.refcount = 1;
+    slice->obj.kind = OBJ_Slice;
+    slice->base = base;
+    slice->chars = view.chars + start; // A rope's flat copy lives as long as the rope.
+    slice->length = length;
+    return runtimeval_string_obj((StringObj *)slice);
+}
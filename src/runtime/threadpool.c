@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L // For sysconf.
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "runtime/threadpool.h"
+
+// The task indices a thread still owns.The owner takes from the front,thieves take the back half.
+typedef struct
+{
+    _Alignas(THREADPOOL_CACHE_LINE) pthread_mutex_t lock;
+    size_t lo;
+    size_t hi;
+} Deque;
+
+typedef struct
+{
+    struct ThreadPool *pool;
+    size_t id;
+} Worker;
+
+struct ThreadPool
+{
+    pthread_t *threads;
+    Worker *workers;
+    Deque *deques; // One per thread,deques[0] belongs to whoever calls threadpool_run.
+    size_t nthreads; // Including the thread that calls threadpool_run.
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    unsigned long generation;
+    TaskFn fn;
+    void *arg;
+    size_t remaining; // Tasks of the current job not finished yet.
+};
+
+static ThreadPool *global_pool = NULL;
+static pthread_once_t global_pool_once = PTHREAD_ONCE_INIT;
+static _Thread_local int inside_pool = 0; // Nested runs just go serial.
+
+static int take(ThreadPool *pool, size_t self, size_t *idx)
+{
+    Deque *own = &pool->deques[self];
+    pthread_mutex_lock(&own->lock);
+    if (own->lo < own->hi)
+    {
+        *idx = own->lo++;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (size_t k = 1; k < pool->nthreads; k++)
+    {
+        Deque *victim = &pool->deques[(self + k) % pool->nthreads];
+        pthread_mutex_lock(&victim->lock);
+        size_t left = victim->hi - victim->lo;
+        if (!left)
+        {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        // Half of what is left,from the end the owner is furthest from.
+        size_t hi = victim->hi;
+        victim->hi -= (left + 1) / 2;
+        size_t lo = victim->hi;
+        pthread_mutex_unlock(&victim->lock);
+
+        *idx = lo;
+        pthread_mutex_lock(&own->lock);
+        own->lo = lo + 1;
+        own->hi = hi;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    return 0;
+}
+
+// Runs tasks of the current job,stealing once its own run out,until no thread has any left.
+static void drain(ThreadPool *pool, size_t self)
+{
+    size_t idx;
+    while (take(pool, self, &idx))
+    {
+        // Whoever filled the deque wrote fn/arg first,and the deque lock orders that before this read.
+        pool->fn(pool->arg, idx);
+        if (!__atomic_sub_fetch(&pool->remaining, 1, __ATOMIC_ACQ_REL))
+        {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->done);
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+}
+
+static void *worker(void *arg)
+{
+    Worker *self = arg;
+    ThreadPool *pool = self->pool;
+    unsigned long seen = 0;
+    inside_pool = 1;
+    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        while (pool->generation == seen)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        drain(pool, self->id);
+        pthread_mutex_lock(&pool->lock);
+    }
+    return NULL;
+}
+
+static size_t pool_size_from_env(void)
+{
+    char *env = getenv("VALEX_THREADS");
+    if (env && *env)
+    {
+        long n = atol(env);
+        return n > 0 ? (size_t)n : 1;
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (size_t)cores : 1;
+}
+
+static void init_global_pool(void)
+{
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    if (!pool)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during initialization of thread pool.\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->nthreads = pool_size_from_env();
+    pool->generation = 0;
+    pool->fn = NULL;
+    pool->arg = NULL;
+    pool->remaining = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->threads = malloc(sizeof(pthread_t) * pool->nthreads);
+    pool->workers = malloc(sizeof(Worker) * pool->nthreads);
+    pool->deques = aligned_alloc(THREADPOOL_CACHE_LINE, sizeof(Deque) * pool->nthreads); // sizeof(Deque) is a multiple of the line.
+    if (!pool->threads || !pool->workers || !pool->deques)
+    {
+        fprintf(stderr, "Memory allocation error. Happened during initialization of thread pool.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < pool->nthreads; i++)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->deques[i].lo = pool->deques[i].hi = 0;
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+    }
+    for (size_t i = 1; i < pool->nthreads; i++) // Thread 0 is whoever calls threadpool_run.
+    {
+        if (pthread_create(&pool->threads[i], NULL, worker, &pool->workers[i]))
+        {
+            fprintf(stderr, "Could not start worker thread %zu of thread pool.\n", i);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pool->threads[i]);
+    }
+    global_pool = pool;
+}
+
+ThreadPool *threadpool_global(void)
+{
+    pthread_once(&global_pool_once, init_global_pool);
+    return global_pool;
+}
+
+size_t threadpool_size(ThreadPool *pool)
+{
+    return pool->nthreads;
+}
+
+void threadpool_run(ThreadPool *pool, TaskFn fn, void *arg, size_t n)
+{
+    if (n == 0)
+        return;
+    if (inside_pool || pool->nthreads < 2 || n == 1)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            fn(arg, i);
+        }
+        return;
+    }
+
+    inside_pool = 1;
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    __atomic_store_n(&pool->remaining, n, __ATOMIC_RELEASE);
+    // Contiguous slices to begin with,so each thread mostly walks neighbouring tasks.
+    for (size_t t = 0; t < pool->nthreads; t++)
+    {
+        pthread_mutex_lock(&pool->deques[t].lock);
+        pool->deques[t].lo = n * t / pool->nthreads;
+        pool->deques[t].hi = n * (t + 1) / pool->nthreads;
+        pthread_mutex_unlock(&pool->deques[t].lock);
+    }
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    drain(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE))
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    inside_pool = 0;
+}
@@ -1,84 +1,298 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <math.h>
 #include "runtime/values.h"
-
-#include "frontend/lexer.h"
+#include "runtime/rope.h"
+#include "runtime/bigint.h"
+#include "runtime/array.h"
+#include "runtime/map.h"
+#include "runtime/record.h"
+#include "runtime/gc.h"
+#include "runtime/slab.h"
+#include "runtime/scratch.h"
 
 RuntimeVal runtimeval_null() 
 {
     RuntimeVal ret;
-    ret.type = VAL_Null;
+    ret.bits = VAL_TAG_NULL;
     return ret;
 }
 
 RuntimeVal runtimeval_number(double val)
 {
     RuntimeVal ret;
-    ret.type = VAL_Number;
-    ret.data.n.value = val;
+    if (val != val)
+    {
+        ret.bits = VAL_CANONICAL_NAN; // Any other NaN could collide with a tag.
+        return ret;
+    }
+    memcpy(&ret.bits, &val, sizeof val);
+    return ret;
+}
+
+RuntimeVal runtimeval_integer(int64_t val)
+{
+    RuntimeVal ret;
+    if (val >= VAL_INLINE_INT_MIN && val <= VAL_INLINE_INT_MAX)
+    {
+        ret.bits = VAL_TAG_INTEGER | ((uint64_t)val & VAL_PAYLOAD_MASK);
+        return ret;
+    }
+    IntegerObj *box = slab_alloc(sizeof(IntegerObj));
+    if (!box)
+    {
+        fprintf(stderr,"Memory allocation error. Happened while boxing integer %" PRId64 ".\n", val);
+        exit(EXIT_FAILURE);
+    }
+    box->obj.refcount = 1;
+    box->obj.kind = OBJ_Integer;
+    box->value = val;
+    return runtimeval_obj(&box->obj);
+}
+
+RuntimeVal runtimeval_obj(Obj *obj)
+{
+    RuntimeVal ret;
+    if ((uintptr_t)obj & ~VAL_PAYLOAD_MASK)
+    {
+        fprintf(stderr,"Object pointer %p does not fit in 48 bits.\n", (void *)obj);
+        exit(EXIT_FAILURE);
+    }
+    ret.bits = VAL_TAG_OBJ | (uint64_t)(uintptr_t)obj;
     return ret;
 }
 
 RuntimeVal runtimeval_bool(bool b)
 {
     RuntimeVal ret;
-    ret.type = VAL_Bool;
-    ret.data.b.value = b;
+    ret.bits = VAL_TAG_BOOL | (b ? 1 : 0);
     return ret;
 }
 
-RuntimeVal runtimeval_string(char *s)
+StringObj *string_alloc(size_t length)
+{
+    StringObj *str = slab_alloc(sizeof(StringObj) + length + 1);
+    if (!str)
+    {
+        fprintf(stderr,"Memory allocation error. Happened while allocating memory for StringVal of length %zu.\n", length);
+        exit(EXIT_FAILURE);
+    }
+    str->obj.refcount = 1;
+    str->obj.kind = OBJ_String;
+    str->length = length;
+    str->capacity = length;
+    str->hash = 0;
+    str->chars[length] = '\0';
+    return str;
+}
+
+StringObj *string_reserve(StringObj *str, size_t length)
+{
+    if (length <= str->capacity)
+        return str;
+    size_t cap = str->capacity > SIZE_MAX / 2 ? length : str->capacity * 2;
+    if (cap < length)
+        cap = length;
+    StringObj *tmp = slab_realloc(str, sizeof(StringObj) + cap + 1);
+    if (!tmp)
+    {
+        fprintf(stderr,"Memory reallocation error. Happened while growing StringVal to length %zu.\n", length);
+        exit(EXIT_FAILURE);
+    }
+    tmp->capacity = cap;
+    return tmp;
+}
+
+RuntimeVal runtimeval_string_obj(StringObj *str)
 {
     RuntimeVal ret;
-    ret.type = VAL_String;
-    ret.data.s.value = my_str_dup(s);
-    if (!ret.data.s.value)
+    if ((uintptr_t)str & ~VAL_PAYLOAD_MASK)
     {
-        fprintf(stderr,"Memory allocation error. Happened while allocating memory for StringVal.\n");
+        fprintf(stderr,"StringVal pointer %p does not fit in 48 bits.\n", (void *)str);
         exit(EXIT_FAILURE);
     }
+    ret.bits = VAL_TAG_STRING | (uint64_t)(uintptr_t)str;
     return ret;
 }
 
-void dump_value(RuntimeVal val)
+RuntimeVal runtimeval_string_len(const char *s, size_t length)
 {
-    switch (val.type)
+    if (length <= VAL_SHORT_STRING_MAX && !memchr(s, '\0', length))
     {
-    case VAL_Number:
-        if ((int)(val.data.n.value) == val.data.n.value) {
-            printf("%.0f\n",val.data.n.value);
-            break;
-        }
-        else if ((int)(val.data.n.value * 10) == (val.data.n.value * 10)) {
-            printf("%.1f\n",val.data.n.value);
-            break;
-        }
-        else if ((int)(val.data.n.value * 100) == (val.data.n.value * 100)) {
-            printf("%.2f\n",val.data.n.value);
-            break;
-        }
-        else if ((int)(val.data.n.value * 1000) == (val.data.n.value * 1000)) {
-            printf("%.3f\n",val.data.n.value);
-            break;
-        }
-        else if ((int)(val.data.n.value * 10000) == (val.data.n.value * 10000)) {
-            printf("%.4f\n",val.data.n.value);
-            break;
+        RuntimeVal ret;
+        uint64_t payload = 0;
+        memcpy(&payload, s, length);
+        ret.bits = VAL_TAG_SHORT_STRING | payload;
+        return ret;
+    }
+    StringObj *str = string_alloc(length);
+    memcpy(str->chars, s, length);
+    return runtimeval_string_obj(str);
+}
+
+RuntimeVal runtimeval_string(char *s)
+{
+    return runtimeval_string_len(s, strlen(s));
+}
+
+uint64_t string_hash(StringObj *str)
+{
+    uint64_t h = __atomic_load_n(&str->hash, __ATOMIC_RELAXED);
+    if (h)
+        return h;
+    h = 14695981039346656037ULL; // FNV-1a
+    for (size_t i = 0; i < str->length; i++)
+    {
+        h ^= (unsigned char)str->chars[i];
+        h *= 1099511628211ULL;
+    }
+    if (!h)
+        h = 1; // 0 means "not computed yet".
+    __atomic_store_n(&str->hash, h, __ATOMIC_RELAXED);
+    return h;
+}
+
+bool string_equals(StringVal a, StringVal b)
+{
+    if (a.length != b.length)
+        return false;
+    if (a.obj && b.obj)
+    {
+        if (a.obj == b.obj)
+            return true;
+        uint64_t ha = __atomic_load_n(&a.obj->hash, __ATOMIC_RELAXED);
+        uint64_t hb = __atomic_load_n(&b.obj->hash, __ATOMIC_RELAXED);
+        if (ha && hb && ha != hb)
+            return false; // Only when both are cached,hashing just for this would cost as much as the memcmp.
+    }
+    return !memcmp(a.chars, b.chars, a.length);
+}
+
+void obj_incref(Obj *obj)
+{
+    __atomic_add_fetch(&obj->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void obj_decref(Obj *obj)
+{
+    if (!__atomic_sub_fetch(&obj->refcount, 1, __ATOMIC_ACQ_REL))
+        gc_release(obj);
+}
+
+size_t format_integer(int64_t value, char *buf)
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char tmp[FORMAT_INTEGER_MAX];
+    char *p = tmp + sizeof tmp;
+    uint64_t u = value < 0 ? 0 - (uint64_t)value : (uint64_t)value; // INT64_MIN has no positive int64_t.
+    while (u >= 100) // Two digits per division.
+    {
+        unsigned pair = (unsigned)(u % 100) * 2;
+        u /= 100;
+        *--p = pairs[pair + 1];
+        *--p = pairs[pair];
+    }
+    if (u >= 10)
+    {
+        *--p = pairs[u * 2 + 1];
+        *--p = pairs[u * 2];
+    }
+    else
+    {
+        *--p = (char)('0' + u);
+    }
+    if (value < 0)
+        *--p = '-';
+    size_t len = tmp + sizeof tmp - p;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return len;
+}
+
+size_t format_number(double n, char *buf, size_t size)
+{
+    // Integral values that fit a double's mantissa skip printf.-0 still goes through it to keep its sign.
+    if (size >= FORMAT_INTEGER_MAX + 1 && fabs(n) < 9007199254740992.0 && floor(n) == n && !(n == 0 && signbit(n)))
+        return format_integer((int64_t)n, buf);
+    // Fewest decimals(up to 5) that represent n exactly,otherwise %f.floor instead of (int) casts,
+    // which overflowed for anything past 2^31.
+    if (isfinite(n))
+    {
+        double scale = 1;
+        for (int decimals = 0; decimals <= 5; decimals++, scale *= 10)
+        {
+            double scaled = n * scale;
+            if (isfinite(scaled) && floor(scaled) == scaled)
+            {
+                return snprintf(buf, size, "%.*f", decimals, n);
+            }
         }
-        else if ((int)(val.data.n.value * 100000) == (val.data.n.value * 100000)) {
-            printf("%.5f\n",val.data.n.value);
+    }
+    return snprintf(buf, size, "%f", n);
+}
+
+void print_number(double n)
+{
+    char buf[64];
+    size_t len = format_number(n, buf, sizeof buf);
+    if (len < sizeof buf)
+    {
+        fwrite(buf, 1, len, stdout);
+        return;
+    }
+    // %f of a large double,like 1e300,has hundreds of digits.
+    char *big = malloc(len + 1);
+    if (!big)
+    {
+        fprintf(stderr,"Memory allocation error. Happened while printing a number.\n");
+        exit(EXIT_FAILURE);
+    }
+    format_number(n, big, len + 1);
+    fwrite(big, 1, len, stdout);
+    free(big);
+}
+
+void print_value(RuntimeVal val)
+{
+    switch (VAL_TYPE(val))
+    {
+    case VAL_Number:
+        print_number(VAL_AS_NUMBER(val));
+        break;
+    case VAL_Integer:
+        if (VAL_IS_BIGINT(val))
+        {
+            ScratchMark mark = scratch_mark();
+            printf("%s",bigint_to_decimal((BigIntObj *)VAL_AS_OBJ(val)));
+            scratch_release(mark);
             break;
         }
-        printf("%f\n",val.data.n.value);
+        printf("%" PRId64,VAL_AS_INTEGER(val));
         break;
     case VAL_Bool:
-        printf(val.data.b.value ? "true\n" : "false\n");
+        printf(VAL_AS_BOOL(val) ? "true" : "false");
         break;
     case VAL_String:
-        printf("%s\n",val.data.s.value);
+    {
+        StringVal str = VAL_AS_STRING(&val);
+        fwrite(str.chars, 1, str.length, stdout);
         break;
+    }
     case VAL_Null:
-        printf("null\n");
+        printf("null");
+        break;
+    case VAL_Array:
+        dump_array((ArrayObj *)VAL_AS_OBJ(val));
+        break;
+    case VAL_Map:
+        dump_map((MapObj *)VAL_AS_OBJ(val));
+        break;
+    case VAL_Record:
+        dump_record((RecordObj *)VAL_AS_OBJ(val));
         break;
     default:
         fprintf(stderr,"Exhaustive handling of ValueType in dump_value.\n");
@@ -86,40 +300,70 @@ void dump_value(RuntimeVal val)
     }
 }
 
+void print_nested_value(RuntimeVal val)
+{
+    if (VAL_IS_STRING(val))
+    {
+        StringVal str = VAL_AS_STRING(&val);
+        printf("\"%.*s\"", (int)str.length, str.chars);
+        return;
+    }
+    print_value(val);
+}
+
+void dump_value(RuntimeVal val)
+{
+    print_value(val);
+    printf("\n");
+}
+
 RuntimeVal copy_value(RuntimeVal value)
 {
-    RuntimeVal ret;
-    switch (value.type)
+    switch (VAL_TYPE(value))
     {
     case VAL_Null:
     case VAL_Number:
     case VAL_Bool:
-        ret = value;
+        break;
+    case VAL_Integer:
+    case VAL_Array:
+    case VAL_Map:
+    case VAL_Record:
+        if (VAL_IS_OBJ(value))
+            obj_incref(VAL_AS_OBJ(value));
         break;
     case VAL_String:
-        ret.type = VAL_String;
-        ret.data.s.value = my_str_dup(value.data.s.value);
+        if (VAL_IS_HEAP_STRING(value))
+            obj_incref(VAL_AS_OBJ(value)); // Strings are immutable,sharing is free.
         break;
     default:
         fprintf(stderr,"Exhaustive handling of ValueType in copy_value.\n");
         exit(EXIT_FAILURE);
     }
-    return ret;
+    return value;
 }
 
 void free_value(RuntimeVal *value)
 {
-    switch (value->type)
+    switch (VAL_TYPE(*value))
     {
     case VAL_Null:
     case VAL_Number:
     case VAL_Bool:
         break;
+    case VAL_Integer:
+    case VAL_Array:
+    case VAL_Map:
+    case VAL_Record:
+        if (VAL_IS_OBJ(*value))
+            obj_decref(VAL_AS_OBJ(*value));
+        break;
     case VAL_String:
-        free(value->data.s.value);
+        if (VAL_IS_HEAP_STRING(*value))
+            obj_decref(VAL_AS_OBJ(*value));
         break;
     default:
         fprintf(stderr,"Exhaustive handling of ValueType in free_value.\n");
         exit(EXIT_FAILURE);
     }
-}
\ No newline at end of file
+}